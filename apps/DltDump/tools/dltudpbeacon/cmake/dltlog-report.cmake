@@ -0,0 +1,129 @@
+# Writes a size and allocation report of the objects in the dltlog library.
+#
+# Run as a script after building the library:
+#
+#   cmake -DLIBRARY=<libdltlog.a> -DNM=<nm> -DSIZE=<size> -DOUTPUT=<report.txt>
+#         [-DEMBEDDED=ON] -P dltlog-report.cmake
+#
+# For each object, the report shows the text, data and bss size, and which
+# undefined symbols it references that allocate on the heap, use exceptions,
+# iostreams or RTTI. The report is a static view of the symbols, it doesn't
+# show how often the heap is used at run time.
+#
+# With EMBEDDED, the build fails if the library references iostreams, or if
+# the encoder, transport and daemon objects use the heap, exceptions or RTTI.
+# The heap backed constructors of dlt are in dlt_heap, so that dlt shows the
+# encoder used by static_dlt only.
+
+if(NOT LIBRARY OR NOT NM OR NOT SIZE OR NOT OUTPUT)
+    message(FATAL_ERROR "dltlog-report: LIBRARY, NM, SIZE and OUTPUT must be given")
+endif()
+
+# The objects that must compile with -fno-exceptions -fno-rtti, and not
+# allocate on the heap.
+set(EMBEDDED_OBJECTS sockaddr4 udp4 dlt dltd)
+
+set(PATTERN_HEAP     "^operator new|^malloc$|^calloc$|^realloc$")
+set(PATTERN_EH       "__cxa_throw|__cxa_rethrow|__cxa_begin_catch|__gxx_personality|_Unwind_Resume")
+set(PATTERN_THROW    "std::__throw_")
+set(PATTERN_IOSTREAM "std::ios_base|std::basic_ostream|std::basic_istream|std::cout|std::cerr|std::clog")
+set(PATTERN_RTTI     "typeinfo|__dynamic_cast")
+
+execute_process(COMMAND "${SIZE}" "${LIBRARY}"
+    OUTPUT_VARIABLE size_output RESULT_VARIABLE size_result)
+execute_process(COMMAND "${NM}" -C -u "${LIBRARY}"
+    OUTPUT_VARIABLE nm_output RESULT_VARIABLE nm_result)
+if(NOT size_result EQUAL 0 OR NOT nm_result EQUAL 0)
+    message(FATAL_ERROR "dltlog-report: couldn't run ${SIZE} or ${NM} on ${LIBRARY}")
+endif()
+
+# The size output has a line per object: "text data bss dec hex object.o (ex lib.a)"
+set(objects "")
+string(REPLACE "\n" ";" size_lines "${size_output}")
+foreach(line IN LISTS size_lines)
+    if(line MATCHES "^[ \t]*([0-9]+)[ \t]+([0-9]+)[ \t]+([0-9]+)[ \t]+[0-9]+[ \t]+[0-9a-fA-F]+[ \t]+([^ \t]+)")
+        get_filename_component(object "${CMAKE_MATCH_4}" NAME_WE)
+        list(APPEND objects ${object})
+        set(text_${object} ${CMAKE_MATCH_1})
+        set(data_${object} ${CMAKE_MATCH_2})
+        set(bss_${object} ${CMAKE_MATCH_3})
+    endif()
+endforeach()
+
+# The nm output starts each object with a line "object.o:", followed by its
+# undefined symbols.
+set(object "")
+string(REPLACE "\n" ";" nm_lines "${nm_output}")
+foreach(line IN LISTS nm_lines)
+    if(line MATCHES "^([^ \t]+\\.o):$")
+        get_filename_component(object "${CMAKE_MATCH_1}" NAME_WE)
+    elseif(object AND line MATCHES "^[ \t]*U[ \t]+(.+)$")
+        set(symbol "${CMAKE_MATCH_1}")
+        foreach(kind HEAP EH THROW IOSTREAM RTTI)
+            if(symbol MATCHES "${PATTERN_${kind}}")
+                set(${kind}_${object} "yes")
+            endif()
+        endforeach()
+    endif()
+endforeach()
+
+set(report "dltlog size and allocation report\n\n")
+string(APPEND report "object           text     data      bss  heap  eh    throw iostr rtti\n")
+set(total_text 0)
+set(total_data 0)
+set(total_bss 0)
+set(errors "")
+foreach(object IN LISTS objects)
+    set(line "${object}                ")
+    string(SUBSTRING "${line}" 0 12 line)
+    foreach(field text data bss)
+        set(value "         ${${field}_${object}}")
+        string(LENGTH "${value}" length)
+        math(EXPR start "${length} - 9")
+        string(SUBSTRING "${value}" ${start} 9 value)
+        string(APPEND line "${value}")
+    endforeach()
+    string(APPEND line " ")
+    foreach(kind HEAP EH THROW IOSTREAM RTTI)
+        if(${kind}_${object})
+            string(APPEND line " yes  ")
+        else()
+            string(APPEND line " -    ")
+        endif()
+    endforeach()
+    string(STRIP "${line}" line)
+    string(APPEND report "${line}\n")
+
+    math(EXPR total_text "${total_text} + ${text_${object}}")
+    math(EXPR total_data "${total_data} + ${data_${object}}")
+    math(EXPR total_bss "${total_bss} + ${bss_${object}}")
+
+    if(EMBEDDED)
+        if(IOSTREAM_${object})
+            list(APPEND errors "${object} references iostreams")
+        endif()
+        list(FIND EMBEDDED_OBJECTS ${object} embedded_object)
+        if(embedded_object GREATER -1)
+            if(HEAP_${object})
+                list(APPEND errors "${object} references the heap")
+            endif()
+            if(EH_${object})
+                list(APPEND errors "${object} references exception handling")
+            endif()
+            if(RTTI_${object})
+                list(APPEND errors "${object} references RTTI")
+            endif()
+        endif()
+    endif()
+endforeach()
+string(APPEND report "\ntotal: text ${total_text}, data ${total_data}, bss ${total_bss}\n")
+string(APPEND report "\nheap: operator new or malloc; eh: throws, catches or unwinds;\n")
+string(APPEND report "throw: standard library helpers that throw, e.g. on allocation failure.\n")
+
+file(WRITE "${OUTPUT}" "${report}")
+message("${report}")
+
+if(errors)
+    string(REPLACE ";" "\n  " errors "${errors}")
+    message(FATAL_ERROR "dltlog-report: not suitable for the embedded profile:\n  ${errors}")
+endif()
@@ -1,13 +1,17 @@
+#include <unistd.h>
+
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <chrono>
 #include <cstring>
-#include <iostream>
 #include <limits>
+#include <thread>
 
 #include "dlt.h"
 
 constexpr int max_dlt_len = std::numeric_limits<uint16_t>().max();
+static_assert(max_dlt_len == rjcp::log::dlt::max_packet, "max_packet mismatch");
 
 constexpr int dlt_id_len = 4;
 
@@ -27,25 +31,39 @@ constexpr uint8_t dlt_htyp_wtms = 1 << 4;        // HTYP.WTMS: With Time Stamp
 constexpr uint8_t dlt_htyp_vers = 1 << 5;        // HTYP.VERS: Version 1
 
 constexpr uint8_t dlt_htyp = dlt_htyp_ueh + dlt_htyp_weid + dlt_htyp_wtms + dlt_htyp_vers;
+constexpr uint8_t dlt_htyp_session = dlt_htyp + dlt_htyp_wsid;
+
+constexpr auto dlt_stdhdr_off_seid(uint8_t htyp) -> int
+{
+    return dlt_stdhdr_off_optional +
+        ((htyp & dlt_htyp_weid) ? dlt_stdhdr_len_ecuid : 0);
+}
+
+constexpr auto dlt_stdhdr_off_time(uint8_t htyp) -> int
+{
+    return dlt_stdhdr_off_seid(htyp) +
+        ((htyp & dlt_htyp_wsid) ? dlt_stdhdr_len_seid : 0);
+}
+
+constexpr auto dlt_stdhdr_len(uint8_t htyp) -> int  // For dlt_htyp=0x35 this is 12.
+{
+    return dlt_stdhdr_off_time(htyp) +
+        ((htyp & dlt_htyp_wtms) ? dlt_stdhdr_len_tmsp : 0);
+}
 
-constexpr int dlt_stdhdr_len =                   // For dlt_htyp=0x35 this is 12.
-    dlt_stdhdr_off_optional +
-    ((dlt_htyp & dlt_htyp_weid) ? dlt_stdhdr_len_ecuid : 0) +
-    ((dlt_htyp & dlt_htyp_wsid) ? dlt_stdhdr_len_seid : 0) +
-    ((dlt_htyp & dlt_htyp_wtms) ? dlt_stdhdr_len_tmsp : 0);
-constexpr int dlt_stdhdr_off_time =
-    dlt_stdhdr_off_optional +
-    ((dlt_htyp & dlt_htyp_weid) ? dlt_stdhdr_len_ecuid : 0) +
-    ((dlt_htyp & dlt_htyp_wsid) ? dlt_stdhdr_len_seid : 0);
-
-constexpr int dlt_exthdr_off_msin = dlt_stdhdr_len;
-constexpr int dlt_exthdr_off_noar = dlt_stdhdr_len + 1;
-constexpr int dlt_exthdr_off_appid = dlt_stdhdr_len + 2;
+// Offsets in the extended header, which immediately follows the standard header.
+constexpr int dlt_exthdr_off_msin = 0;
+constexpr int dlt_exthdr_off_noar = 1;
+constexpr int dlt_exthdr_off_appid = 2;
 constexpr int dlt_exthdr_len_appid = dlt_id_len;
 constexpr int dlt_exthdr_off_ctxid = dlt_exthdr_off_appid + dlt_exthdr_len_appid;
 constexpr int dlt_exthdr_len_ctxid = dlt_id_len;
+constexpr int dlt_exthdr_len = dlt_exthdr_off_ctxid + dlt_exthdr_len_ctxid;
 
-constexpr int dlt_payload_off = dlt_exthdr_off_ctxid + dlt_exthdr_len_ctxid;
+constexpr auto dlt_payload_off(uint8_t htyp) -> int
+{
+    return dlt_stdhdr_len(htyp) + dlt_exthdr_len;
+}
 
 constexpr uint8_t dlt_exthdr_msin_verbose = 1 << 0;
 constexpr uint8_t dlt_exthdr_mstp_dltlogfatal = 0x10;
@@ -54,6 +72,19 @@ constexpr uint8_t dlt_exthdr_mstp_dltlogwarn = 0x30;
 constexpr uint8_t dlt_exthdr_mstp_dltloginfo = 0x40;
 constexpr uint8_t dlt_exthdr_mstp_dltlogdebug = 0x50;
 constexpr uint8_t dlt_exthdr_mstp_dltlogverbose = 0x60;
+constexpr uint8_t dlt_exthdr_mstp_nwtrace = 0x04;           // MSTP: DLT_TYPE_NW_TRACE
+constexpr uint8_t dlt_exthdr_mtin_nwtrace_ipc = 0x10;       // MTIN: DLT_NW_TRACE_IPC
+
+constexpr int dlt_type_nw_trace = 2;                        // DLT_TYPE_NW_TRACE
+constexpr int dlt_exthdr_msin_mstp_shift = 1;               // MSTP is in bits 1-3 of MSIN
+constexpr uint8_t dlt_exthdr_msin_mstp_mask = 0x07;
+
+constexpr auto dlt_msin_mstp(uint8_t msin) -> int
+{
+    return (msin >> dlt_exthdr_msin_mstp_shift) & dlt_exthdr_msin_mstp_mask;
+}
+
+static_assert(dlt_msin_mstp(dlt_exthdr_mstp_nwtrace) == dlt_type_nw_trace, "MSTP must be DLT_TYPE_NW_TRACE");
 
 constexpr int dlt_arg_len_typeinfo = 4;     // Lenth of the argument typeinfo field
 constexpr int dlt_arg_string_len_len = 2;   // Length of the string argument length field
@@ -61,37 +92,70 @@ constexpr int dlt_arg_string_len_null = 1;  // Length of the string argument nul
 constexpr int dlt_arg_string_off_payload =
     dlt_arg_len_typeinfo + dlt_arg_string_len_len;
 
+constexpr int dlt_arg_raw_len_len = 2;      // Length of the raw argument length field
+constexpr int dlt_arg_len_uint16 = dlt_arg_len_typeinfo + sizeof(uint16_t);
+constexpr int dlt_arg_len_uint32 = dlt_arg_len_typeinfo + sizeof(uint32_t);
+constexpr int dlt_arg_raw_off_payload = dlt_arg_len_typeinfo + dlt_arg_raw_len_len;
+
+constexpr uint32_t dlt_arg_typeinfo_uint16 = 0x00000042;
+constexpr uint32_t dlt_arg_typeinfo_uint32 = 0x00000043;
 constexpr uint32_t dlt_arg_typeinfo_string = 0x00000200;
+constexpr uint32_t dlt_arg_typeinfo_raw = 0x00000400;
 
-constexpr int dlt_chrono_time = 100;        // Convert microseconds to dlt units
+// Segmented network trace messages, as sent by dlt_user_trace_network_segmented()
+// of the COVESA DLT daemon. A start message, chunks, and an end message.
+constexpr std::string_view dlt_nwtrace_start = "NWST";
+constexpr std::string_view dlt_nwtrace_chunk = "NWCH";
+constexpr std::string_view dlt_nwtrace_end = "NWEN";
+constexpr uint8_t dlt_nwtrace_noar_start = 6;   // "NWST", id, header, length, segment count, segment length
+constexpr uint8_t dlt_nwtrace_noar_chunk = 4;   // "NWCH", id, sequence, data
+constexpr uint8_t dlt_nwtrace_noar_end = 2;     // "NWEN", id
 
-static void write4hdr(const std::string& id, std::vector<uint8_t>& packet, const std::size_t offset)
+constexpr auto dlt_arg_len_string(std::size_t length) -> int
 {
-    assert(offset + dlt_id_len <= packet.size());
+    return dlt_arg_string_off_payload + length + dlt_arg_string_len_null;
+}
+
+static_assert(dlt_payload_off(dlt_htyp_session) == rjcp::log::dlt::max_header, "max_header mismatch");
+static_assert(rjcp::log::dlt::packet_len(0) == static_cast<std::size_t>(dlt_payload_off(dlt_htyp_session) + dlt_arg_len_string(0)), "packet_len mismatch");
 
+// Each chunk is sized so that a packet fits into one Ethernet frame (MTU
+// 1500, less the IPv4 and UDP headers), even with a Session-ID.
+constexpr int dlt_udp_mtu_payload = rjcp::log::dlt::segment_packet;
+constexpr int dlt_segment_len =
+    dlt_udp_mtu_payload -
+    dlt_payload_off(dlt_htyp_session) -
+    dlt_arg_len_string(dlt_nwtrace_chunk.size()) -
+    dlt_arg_len_uint32 -
+    dlt_arg_len_uint16 -
+    dlt_arg_raw_off_payload;
+constexpr std::size_t dlt_segment_max = std::numeric_limits<uint16_t>::max();
+constexpr std::size_t dlt_ns_per_sec = 1000000000;
+
+constexpr int dlt_chrono_time = 100;        // Convert microseconds to dlt units
+
+static void write4hdr(std::string_view id, std::uint8_t* packet, const std::size_t offset)
+{
     size_t id_length = std::min(id.length(), size_t(dlt_id_len));
     if (id_length < dlt_id_len)
-        std::memset(packet.data(), 0, dlt_id_len);
+        std::memset(&packet[offset], 0, dlt_id_len);
 
     std::memcpy(&packet[offset], id.data(), id_length);
 }
 
-template<typename T>
-void write16be(std::vector<T>& buffer, const std::size_t offset, const uint16_t value)
+static void write16be(std::uint8_t* buffer, const std::size_t offset, const uint16_t value)
 {
     buffer[offset]     = (value >> 8) & 0xFF;      // NOLINT(cppcoreguidelines-avoid-magic-numbers)
     buffer[offset + 1] = value & 0xFF;             // NOLINT(cppcoreguidelines-avoid-magic-numbers)
 }
 
-template<typename T>
-void write16le(std::vector<T>& buffer, const std::size_t offset, const uint16_t value)
+static void write16le(std::uint8_t* buffer, const std::size_t offset, const uint16_t value)
 {
     buffer[offset]     = value & 0xFF;             // NOLINT(cppcoreguidelines-avoid-magic-numbers)
     buffer[offset + 1] = (value >> 8) & 0xFF;      // NOLINT(cppcoreguidelines-avoid-magic-numbers)
 }
 
-template<typename T>
-void write32be(std::vector<T>&buffer, const std::size_t offset, const uint32_t value)
+static void write32be(std::uint8_t* buffer, const std::size_t offset, const uint32_t value)
 {
     buffer[offset]     = (value >> 24) & 0xFF;     // NOLINT(cppcoreguidelines-avoid-magic-numbers)
     buffer[offset + 1] = (value >> 16) & 0xFF;     // NOLINT(cppcoreguidelines-avoid-magic-numbers)
@@ -99,8 +163,7 @@ void write32be(std::vector<T>&buffer, const std::size_t offset, const uint32_t v
     buffer[offset + 3] = value & 0xFF;             // NOLINT(cppcoreguidelines-avoid-magic-numbers)
 }
 
-template<typename T>
-void write32le(std::vector<T>& buffer, const std::size_t offset, const uint32_t value)
+static void write32le(std::uint8_t* buffer, const std::size_t offset, const uint32_t value)
 {
     buffer[offset]     = value & 0xFF;             // NOLINT(cppcoreguidelines-avoid-magic-numbers)
     buffer[offset + 1] = (value >> 8) & 0xFF;      // NOLINT(cppcoreguidelines-avoid-magic-numbers)
@@ -108,47 +171,339 @@ void write32le(std::vector<T>& buffer, const std::size_t offset, const uint32_t
     buffer[offset + 3] = (value >> 24) & 0xFF;     // NOLINT(cppcoreguidelines-avoid-magic-numbers)
 }
 
-rjcp::log::dlt::dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, const std::string& ecuid, const std::string& appid, const std::string& ctxid) noexcept
-    : m_sender{sender}
-    , m_dest{dest}
-    , m_packet(max_dlt_len + 1)
+static auto read16be(const std::uint8_t* buffer, const std::size_t offset) -> uint16_t
 {
-    this->m_packet[dlt_stdhdr_off_htyp] = dlt_htyp;
-    write4hdr(ecuid, m_packet, dlt_stdhdr_off_optional);
+    return (buffer[offset] << 8) | buffer[offset + 1];  // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+}
+
+static auto read16le(const std::uint8_t* buffer, const std::size_t offset) -> uint16_t
+{
+    return buffer[offset] | (buffer[offset + 1] << 8);  // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+}
 
+static auto read32le(const std::uint8_t* buffer, const std::size_t offset) -> uint32_t
+{
+    return buffer[offset] |                             // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+        (buffer[offset + 1] << 8) |                     // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+        (buffer[offset + 2] << 16) |                    // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+        (static_cast<uint32_t>(buffer[offset + 3]) << 24);  // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+}
+
+static auto write_arg_uint16(std::uint8_t* packet, const std::size_t offset, const uint16_t value) -> std::size_t
+{
+    write32le(packet, offset, dlt_arg_typeinfo_uint16);
+    write16le(packet, offset + dlt_arg_len_typeinfo, value);
+    return offset + dlt_arg_len_uint16;
+}
+
+static auto write_arg_uint32(std::uint8_t* packet, const std::size_t offset, const uint32_t value) -> std::size_t
+{
+    write32le(packet, offset, dlt_arg_typeinfo_uint32);
+    write32le(packet, offset + dlt_arg_len_typeinfo, value);
+    return offset + dlt_arg_len_uint32;
+}
+
+static auto write_arg_string(std::uint8_t* packet, const std::size_t offset, std::string_view value) -> std::size_t
+{
+    write32le(packet, offset, dlt_arg_typeinfo_string);
+    write16le(packet, offset + dlt_arg_len_typeinfo, value.size() + dlt_arg_string_len_null);
+    std::memcpy(&packet[offset + dlt_arg_string_off_payload], value.data(), value.size());
+    packet[offset + dlt_arg_string_off_payload + value.size()] = 0;
+    return offset + dlt_arg_len_string(value.size());
+}
+
+// Writes the type and length of a raw argument. The caller writes the data at
+// the offset returned.
+static auto write_arg_raw(std::uint8_t* packet, const std::size_t offset, const uint16_t length) -> std::size_t
+{
+    write32le(packet, offset, dlt_arg_typeinfo_raw);
+    write16le(packet, offset + dlt_arg_len_typeinfo, length);
+    return offset + dlt_arg_raw_off_payload;
+}
+
+static void write_header(std::uint8_t* packet, const uint8_t htyp, std::string_view ecuid, std::string_view appid, std::string_view ctxid)
+{
     constexpr uint8_t dlt_exthdr_mstp_noar = 1;
+    const int exthdr = dlt_stdhdr_len(htyp);
+
+    packet[dlt_stdhdr_off_htyp] = htyp;
+    write4hdr(ecuid, packet, dlt_stdhdr_off_optional);
 
-    this->m_packet[dlt_exthdr_off_msin] = dlt_exthdr_mstp_dltloginfo + dlt_exthdr_msin_verbose;
-    this->m_packet[dlt_exthdr_off_noar] = dlt_exthdr_mstp_noar;
-    write4hdr(appid, m_packet, dlt_exthdr_off_appid);
-    write4hdr(ctxid, m_packet, dlt_exthdr_off_ctxid);
+    packet[exthdr + dlt_exthdr_off_msin] = dlt_exthdr_mstp_dltloginfo + dlt_exthdr_msin_verbose;
+    packet[exthdr + dlt_exthdr_off_noar] = dlt_exthdr_mstp_noar;
+    write4hdr(appid, packet, exthdr + dlt_exthdr_off_appid);
+    write4hdr(ctxid, packet, exthdr + dlt_exthdr_off_ctxid);
 }
 
-auto rjcp::log::dlt::write(const std::string& message) noexcept -> int
+rjcp::log::dlt::dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, std::string_view ecuid, std::string_view appid, std::string_view ctxid, std::optional<std::uint32_t> seid, const storage& buffers) noexcept
+    : m_sender{sender}
+    , m_dest{dest}
+    , m_storage{buffers}
 {
-    const std::size_t msg_len = message.size() + dlt_arg_string_len_null;
-    const std::size_t packet_len =
-        dlt_payload_off +
-        dlt_arg_string_off_payload +
-        msg_len;
+    this->init(ecuid, appid, ctxid, seid);
+}
 
-    if (packet_len > max_dlt_len) {
-        errno = EINVAL;
+void rjcp::log::dlt::init(std::string_view ecuid, std::string_view appid, std::string_view ctxid, std::optional<std::uint32_t> seid) noexcept
+{
+    const uint8_t htyp = seid ? dlt_htyp_session : dlt_htyp;
+    assert(this->m_storage.packet_len > static_cast<std::size_t>(dlt_payload_off(htyp)));
+
+    write_header(this->m_storage.packet, htyp, ecuid, appid, ctxid);
+    if (seid)
+        write32be(this->m_storage.packet, dlt_stdhdr_off_seid(htyp), *seid);
+}
+
+auto rjcp::log::dlt::write(std::string_view message) noexcept -> int
+{
+    int packet_len = this->encode(message, this->m_storage.packet, this->m_storage.packet_len);
+    if (packet_len < 0)
         return -1;
-    }
+
+    return this->m_sender.send(this->m_dest, this->m_storage.packet, packet_len);
+}
+
+auto rjcp::log::dlt::payload_off() const noexcept -> std::size_t
+{
+    return dlt_payload_off(this->m_storage.packet[dlt_stdhdr_off_htyp]);
+}
+
+void rjcp::log::dlt::header(std::uint8_t* packet, std::size_t packet_len, std::uint8_t msin, std::uint8_t noar) noexcept
+{
+    const uint8_t htyp = this->m_storage.packet[dlt_stdhdr_off_htyp];
+    const int exthdr = dlt_stdhdr_len(htyp);
 
     const std::chrono::time_point<std::chrono::steady_clock> clocktime = std::chrono::steady_clock::now();
     const std::chrono::steady_clock::duration duration = clocktime.time_since_epoch();
     const uint32_t devtime = std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / dlt_chrono_time;
 
-    this->m_packet[dlt_stdhdr_off_mcnt] = this->m_count;
-    write16be(this->m_packet, dlt_stdhdr_off_len, packet_len);
-    write32be(this->m_packet, dlt_stdhdr_off_time, devtime);
-    write32le(this->m_packet, dlt_payload_off, dlt_arg_typeinfo_string);
-    write16le(this->m_packet, dlt_payload_off + dlt_arg_len_typeinfo, msg_len);
-    std::memcpy(&this->m_packet[dlt_payload_off + dlt_arg_string_off_payload], message.c_str(), msg_len);
-    this->m_packet[packet_len] = 0;
+    if (packet != this->m_storage.packet)
+        std::memcpy(packet, this->m_storage.packet, this->payload_off());
+
+    packet[dlt_stdhdr_off_mcnt] = this->m_count;
+    write16be(packet, dlt_stdhdr_off_len, packet_len);
+    write32be(packet, dlt_stdhdr_off_time(htyp), devtime);
+    packet[exthdr + dlt_exthdr_off_msin] = msin;    // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    packet[exthdr + dlt_exthdr_off_noar] = noar;    // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
 
     this->m_count = (this->m_count + 1) & 0xFF;  // NOLINT(cppcoreguidelines-avoid-magic-numbers)
-    return this->m_sender.send(this->m_dest, this->m_packet, packet_len);
+}
+
+auto rjcp::log::dlt::encode(std::string_view message, std::uint8_t* packet, std::size_t packet_len) noexcept -> int
+{
+    const std::size_t payload_off = this->payload_off();
+    const std::size_t msg_packet_len = payload_off + dlt_arg_len_string(message.size());
+
+    if (msg_packet_len > max_dlt_len || msg_packet_len > packet_len) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    write_arg_string(packet, payload_off, message);
+    this->header(packet, msg_packet_len, dlt_exthdr_mstp_dltloginfo + dlt_exthdr_msin_verbose, 1);
+    return static_cast<int>(msg_packet_len);
+}
+
+void rjcp::log::dlt::set_segment_rate(std::size_t bytes_per_sec) noexcept
+{
+    this->m_segment_rate = bytes_per_sec;
+}
+
+auto rjcp::log::dlt::write_segmented(const std::uint8_t* buffer, std::size_t length) noexcept -> int
+{
+    if (buffer == nullptr) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    std::size_t offset = 0;
+    return this->write_segments(length, [buffer, &offset](std::uint8_t* chunk, std::size_t chunk_len) {
+        std::memcpy(chunk, buffer + offset, chunk_len);  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        offset += chunk_len;
+        return 0;
+    });
+}
+
+auto rjcp::log::dlt::write_segmented(int fd, std::size_t length) noexcept -> int
+{
+    if (fd < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return this->write_segments(length, [fd](std::uint8_t* chunk, std::size_t chunk_len) {
+        std::size_t offset = 0;
+        while (offset < chunk_len) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            ssize_t nbytes = ::read(fd, chunk + offset, chunk_len - offset);
+            if (nbytes < 0) {
+                if (errno == EINTR)
+                    continue;
+                return -1;
+            }
+            if (nbytes == 0) {
+                // The file is shorter than announced in the start message.
+                errno = ENODATA;
+                return -1;
+            }
+            offset += nbytes;
+        }
+        return 0;
+    });
+}
+
+template<typename Reader>
+auto rjcp::log::dlt::write_segments(std::size_t length, Reader reader) noexcept -> int
+{
+    const std::size_t segments = (length + dlt_segment_len - 1) / dlt_segment_len;
+    if (length == 0 || segments > dlt_segment_max) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (this->m_storage.segments == nullptr && !this->alloc_segments()) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    // A full batch is sent before the next packet is queued, so any batch
+    // size works.
+    const std::size_t batch = this->m_storage.segment_batch;
+
+    constexpr uint8_t msin = dlt_exthdr_mstp_nwtrace + dlt_exthdr_mtin_nwtrace_ipc + dlt_exthdr_msin_verbose;
+    const std::uint32_t id = ++this->m_segment_id;
+    auto next_packet = [this]() {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        return this->m_storage.segments + this->m_segment_count * dlt_udp_mtu_payload;
+    };
+    auto queue_packet = [this](std::uint8_t* packet, std::size_t packet_len) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        this->m_storage.datagrams[this->m_segment_count++] = rjcp::net::udp4::datagram{packet, packet_len};
+    };
+
+    std::uint8_t* packet = next_packet();
+    std::size_t offset = this->payload_off();
+    offset = write_arg_string(packet, offset, dlt_nwtrace_start);
+    offset = write_arg_uint32(packet, offset, id);
+    offset = write_arg_raw(packet, offset, 0);
+    offset = write_arg_uint32(packet, offset, length);
+    offset = write_arg_uint16(packet, offset, segments);
+    offset = write_arg_uint16(packet, offset, dlt_segment_len);
+    this->header(packet, offset, msin, dlt_nwtrace_noar_start);
+    queue_packet(packet, offset);
+
+    // Each chunk is read directly into the packet, so the caller's data is
+    // never copied as a whole.
+    int res = 0;
+    int err = 0;
+    for (std::size_t seq = 0; seq < segments; seq++) {
+        if (this->m_segment_count == batch && this->flush_segments() < 0) {
+            res = -1;
+            err = errno;
+            break;
+        }
+
+        const std::size_t chunk_len = std::min(length - seq * dlt_segment_len, std::size_t{dlt_segment_len});
+        packet = next_packet();
+        offset = this->payload_off();
+        offset = write_arg_string(packet, offset, dlt_nwtrace_chunk);
+        offset = write_arg_uint32(packet, offset, id);
+        offset = write_arg_uint16(packet, offset, seq);
+        offset = write_arg_raw(packet, offset, chunk_len);
+        if (reader(&packet[offset], chunk_len) < 0) {  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            res = -1;
+            err = errno;
+            break;
+        }
+
+        offset += chunk_len;
+        this->header(packet, offset, msin, dlt_nwtrace_noar_chunk);
+        queue_packet(packet, offset);
+    }
+
+    // Always end the transfer, so that the receiver can free its resources.
+    if (this->m_segment_count == batch && this->flush_segments() < 0 && res == 0) {
+        res = -1;
+        err = errno;
+    }
+
+    packet = next_packet();
+    offset = this->payload_off();
+    offset = write_arg_string(packet, offset, dlt_nwtrace_end);
+    offset = write_arg_uint32(packet, offset, id);
+    this->header(packet, offset, msin, dlt_nwtrace_noar_end);
+    queue_packet(packet, offset);
+
+    if (this->flush_segments() < 0 && res == 0) {
+        res = -1;
+        err = errno;
+    }
+
+    if (res < 0)
+        errno = err;
+    return res;
+}
+
+auto rjcp::log::dlt::flush_segments() noexcept -> int
+{
+    if (this->m_segment_count == 0)
+        return 0;
+
+    if (this->m_segment_rate > 0) {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (this->m_segment_next > now) {
+            std::this_thread::sleep_until(this->m_segment_next);
+        } else {
+            this->m_segment_next = now;
+        }
+    }
+
+    int res = this->m_sender.send(this->m_dest, this->m_storage.datagrams, this->m_segment_count);
+
+    if (this->m_segment_rate > 0) {
+        std::size_t bytes = 0;
+        for (std::size_t i = 0; i < this->m_segment_count; i++)
+            bytes += this->m_storage.datagrams[i].length;  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        this->m_segment_next += std::chrono::nanoseconds(bytes * dlt_ns_per_sec / this->m_segment_rate);
+    }
+
+    this->m_segment_count = 0;
+    return res;
+}
+
+auto rjcp::log::dlt::decode(const std::uint8_t* packet, std::size_t length, std::uint8_t& mcnt, std::string_view& message) noexcept -> int
+{
+    if (packet == nullptr || length < dlt_stdhdr_off_optional) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    const uint8_t htyp = packet[dlt_stdhdr_off_htyp];
+    const std::size_t payload_off = dlt_payload_off(htyp);
+    if ((htyp & dlt_htyp_ueh) == 0 || (htyp & dlt_htyp_msbf) != 0 ||
+        read16be(packet, dlt_stdhdr_off_len) != length ||
+        length < payload_off + dlt_arg_string_off_payload) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    const int exthdr = dlt_stdhdr_len(htyp);
+    if ((packet[exthdr + dlt_exthdr_off_msin] & dlt_exthdr_msin_verbose) == 0 ||
+        packet[exthdr + dlt_exthdr_off_noar] != 1 ||
+        (read32le(packet, payload_off) & dlt_arg_typeinfo_string) == 0) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    const std::size_t msg_len = read16le(packet, payload_off + dlt_arg_len_typeinfo);
+    if (msg_len < dlt_arg_string_len_null ||
+        payload_off + dlt_arg_string_off_payload + msg_len > length) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    mcnt = packet[dlt_stdhdr_off_mcnt];
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast): Systems programming.
+    message = std::string_view(reinterpret_cast<const char*>(&packet[payload_off + dlt_arg_string_off_payload]),
+        msg_len - dlt_arg_string_len_null);
+    return 0;
 }
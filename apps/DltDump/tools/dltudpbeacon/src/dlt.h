@@ -2,7 +2,11 @@
 #define RJCP_DLT_XX_H
 
 #include <array>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
 #include <vector>
 
 #include "sockaddr4.h"
@@ -12,11 +16,58 @@ namespace rjcp::log {
     /**
      * @brief A very simple class to send out DLT messages as strings.
      *
+     * The buffers are allocated on the heap when constructed, and for
+     * segmented messages when first used. Use static_dlt for buffers of a
+     * fixed size that are not allocated.
+     *
      * You should assume that all methods are not thread safe.
      *
      */
     class dlt {
     public:
+        /**
+         * @brief The maximum length of a DLT packet, as the length field is 16 bits.
+         */
+        static constexpr std::size_t max_packet = 65535;
+
+        /**
+         * @brief The maximum length of the standard and extended header, with a Session-ID.
+         */
+        static constexpr std::size_t max_header = 26;
+
+        /**
+         * @brief The length of each packet of a segmented message, so it fits into an Ethernet MTU.
+         */
+        static constexpr std::size_t segment_packet = 1472;
+
+        /**
+         * @brief The default rate limit of segmented messages, in bytes per second.
+         */
+        static constexpr std::size_t default_segment_rate = 1024 * 1024;
+
+        /**
+         * @brief The buffers a dlt object encodes packets into.
+         */
+        struct storage {
+            std::uint8_t* packet;                       // The packet for write(), also the header template
+            std::size_t packet_len;                     // The length of packet
+            std::uint8_t* segments;                     // segment_batch packets of segment_packet bytes, may be nullptr
+            rjcp::net::udp4::datagram* datagrams;       // segment_batch datagrams for the segments
+            std::size_t segment_batch;                  // The number of segments sent together
+        };
+
+        /**
+         * @brief Gets the length of the packet written by write() for a message.
+         *
+         * @param message_len The length of the message string.
+         * @return std::size_t The maximum length of the packet, with a Session-ID.
+         */
+        static constexpr auto packet_len(std::size_t message_len) -> std::size_t
+        {
+            constexpr std::size_t string_arg = 7;       // Type info, length and NUL terminator
+            return max_header + string_arg + message_len;
+        }
+
         /**
          * @brief Construct a new dlt object
          *
@@ -26,7 +77,36 @@ namespace rjcp::log {
          * @param appid The Application-ID (4 characters) in the extended header.
          * @param ctxid The Context-ID (4 characters) in the extended header.
          */
-        dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, const std::string& ecuid, const std::string& appid, const std::string& ctxid) noexcept;
+        dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, std::string_view ecuid, std::string_view appid, std::string_view ctxid) noexcept;
+
+        /**
+         * @brief Construct a new dlt object that writes a Session-ID in the standard header
+         *
+         * @param sender The sender socket. Must already be opened and bound to before writing.
+         * @param dest The address to send to (could be a multicast address).
+         * @param ecuid The ECU-ID (4 characters) in the standard header.
+         * @param appid The Application-ID (4 characters) in the extended header.
+         * @param ctxid The Context-ID (4 characters) in the extended header.
+         * @param seid The Session-ID in the standard header.
+         */
+        dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, std::string_view ecuid, std::string_view appid, std::string_view ctxid, std::uint32_t seid) noexcept;
+
+        /**
+         * @brief Construct a new dlt object that encodes into the buffers given
+         *
+         * @param sender The sender socket. Must already be opened and bound to before writing.
+         * @param dest The address to send to (could be a multicast address).
+         * @param ecuid The ECU-ID (4 characters) in the standard header.
+         * @param appid The Application-ID (4 characters) in the extended header.
+         * @param ctxid The Context-ID (4 characters) in the extended header.
+         * @param seid The Session-ID in the standard header, if any.
+         * @param buffers The buffers to encode into, which must outlive this object.
+         * The packet must be longer than max_header.
+         */
+        dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, std::string_view ecuid, std::string_view appid, std::string_view ctxid, std::optional<std::uint32_t> seid, const storage& buffers) noexcept;
+
+        dlt(const dlt&) = delete;
+        auto operator=(const dlt&) -> dlt& = delete;
 
         /**
          * @brief Destroy the dlt object
@@ -43,13 +123,152 @@ namespace rjcp::log {
          * @param message The payload string
          * @return int Success if zero, -1 on error. Check errno.
          */
-        auto write(const std::string& message) noexcept -> int;
+        auto write(std::string_view message) noexcept -> int;
+
+        /**
+         * @brief Encode the string message as a DLT packet without sending it
+         *
+         * This is the same packet as written by write(), so that many packets
+         * can be prepared first and then sent together with udp4::send().
+         *
+         * @param message The payload string
+         * @param packet The buffer to encode the packet into.
+         * @param packet_len The length of packet. Must be large enough for the whole packet, see packet_len().
+         * @return int The length of the packet if positive, -1 on error. Check errno.
+         */
+        auto encode(std::string_view message, std::uint8_t* packet, std::size_t packet_len) noexcept -> int;
+
+        /**
+         * @brief Limit the rate that segmented messages are sent.
+         *
+         * Without a limit, a large transfer is sent as fast as the socket
+         * allows, which can starve other log traffic on the network. The rate
+         * is limited to default_segment_rate, unless set otherwise.
+         *
+         * @param bytes_per_sec The maximum rate in bytes per second, including
+         * the DLT headers. Zero is unlimited.
+         */
+        void set_segment_rate(std::size_t bytes_per_sec) noexcept;
+
+        /**
+         * @brief Write a large buffer as a segmented network trace message
+         *
+         * Sends a start message, the buffer in chunks that each fit into an
+         * Ethernet MTU, and an end message. Each chunk is copied from the buffer
+         * directly into its packet, and the packets are sent in batches. This
+         * method returns when all packets are sent, which is limited by
+         * set_segment_rate().
+         *
+         * @param buffer The data to send.
+         * @param length The number of bytes in buffer to send.
+         * @return int Success if zero, -1 on error. Check errno, which is ENOBUFS
+         * if there are no buffers for segments.
+         */
+        auto write_segmented(const std::uint8_t* buffer, std::size_t length) noexcept -> int;
+
+        /**
+         * @brief Write from a file descriptor as a segmented network trace message
+         *
+         * As write_segmented() for a buffer, but each chunk is read from the
+         * file descriptor directly into its packet.
+         *
+         * @param fd The file descriptor to read from.
+         * @param length The number of bytes to read and send.
+         * @return int Success if zero, -1 on error. Check errno, which is ENODATA
+         * if the file ends before length bytes.
+         */
+        auto write_segmented(int fd, std::size_t length) noexcept -> int;
+
+        /**
+         * @brief Decode a DLT packet with a single string argument, as written by write()
+         *
+         * @param packet The buffer with the received packet.
+         * @param length The length of the received packet.
+         * @param mcnt Receives the message counter of the standard header.
+         * @param message Receives the string argument, without the NUL terminator. It refers to packet.
+         * @return int Success if zero, -1 on error. Check errno, which is EBADMSG
+         * if the packet is not a verbose message with a single string argument.
+         */
+        static auto decode(const std::uint8_t* packet, std::size_t length, std::uint8_t& mcnt, std::string_view& message) noexcept -> int;
 
     private:
+        void init(std::string_view ecuid, std::string_view appid, std::string_view ctxid, std::optional<std::uint32_t> seid) noexcept;
+        auto alloc_segments() noexcept -> bool;
+        auto payload_off() const noexcept -> std::size_t;
+        void header(std::uint8_t* packet, std::size_t packet_len, std::uint8_t msin, std::uint8_t noar) noexcept;
+        template<typename Reader>
+        auto write_segments(std::size_t length, Reader reader) noexcept -> int;
+        auto flush_segments() noexcept -> int;
+
         rjcp::net::udp4& m_sender;
         const rjcp::net::sockaddr4& m_dest;
         std::uint8_t m_count{0};
-        std::vector<uint8_t> m_packet;
+        std::vector<uint8_t> m_heap_packet;
+        std::vector<uint8_t> m_heap_segments;
+        std::vector<rjcp::net::udp4::datagram> m_heap_datagrams;
+        storage m_storage;
+        std::uint32_t m_segment_id{0};
+        std::size_t m_segment_rate{default_segment_rate};
+        std::chrono::steady_clock::time_point m_segment_next{};
+        std::size_t m_segment_count{0};
+    };
+
+    /**
+     * @brief The buffers of a static_dlt, which must be constructed before the dlt.
+     */
+    template<std::size_t PacketLen, std::size_t SegmentBatch>
+    class static_dlt_storage {
+    protected:
+        auto buffers() noexcept -> dlt::storage
+        {
+            return dlt::storage{
+                m_packet.data(), m_packet.size(),
+                SegmentBatch > 0 ? m_segments.data() : nullptr,
+                m_datagrams.data(), SegmentBatch };
+        }
+
+    private:
+        std::array<std::uint8_t, PacketLen> m_packet{};
+        std::array<std::uint8_t, SegmentBatch * dlt::segment_packet> m_segments{};
+        std::array<rjcp::net::udp4::datagram, SegmentBatch> m_datagrams{};
+    };
+
+    /**
+     * @brief A dlt object with buffers of a fixed size, that doesn't allocate.
+     *
+     * @tparam PacketLen The maximum length of a packet for write(), see dlt::packet_len().
+     * @tparam SegmentBatch The number of packets of write_segmented() sent
+     * together. If zero, write_segmented() can't be used.
+     */
+    template<std::size_t PacketLen, std::size_t SegmentBatch = 0>
+    class static_dlt : private static_dlt_storage<PacketLen, SegmentBatch>, public dlt {
+        static_assert(PacketLen > dlt::max_header && PacketLen <= dlt::max_packet + 1, "PacketLen out of range");
+
+    public:
+        /**
+         * @brief Construct a new static_dlt object
+         *
+         * @param sender The sender socket. Must already be opened and bound to before writing.
+         * @param dest The address to send to (could be a multicast address).
+         * @param ecuid The ECU-ID (4 characters) in the standard header.
+         * @param appid The Application-ID (4 characters) in the extended header.
+         * @param ctxid The Context-ID (4 characters) in the extended header.
+         */
+        static_dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, std::string_view ecuid, std::string_view appid, std::string_view ctxid) noexcept
+            : dlt(sender, dest, ecuid, appid, ctxid, std::nullopt, this->buffers()) { }
+
+        /**
+         * @brief Construct a new static_dlt object that writes a Session-ID in the standard header
+         *
+         * @param sender The sender socket. Must already be opened and bound to before writing.
+         * @param dest The address to send to (could be a multicast address).
+         * @param ecuid The ECU-ID (4 characters) in the standard header.
+         * @param appid The Application-ID (4 characters) in the extended header.
+         * @param ctxid The Context-ID (4 characters) in the extended header.
+         * @param seid The Session-ID in the standard header.
+         */
+        static_dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, std::string_view ecuid, std::string_view appid, std::string_view ctxid, std::uint32_t seid) noexcept
+            : dlt(sender, dest, ecuid, appid, ctxid, seid, this->buffers()) { }
     };
 }
 
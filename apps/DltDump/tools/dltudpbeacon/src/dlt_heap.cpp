@@ -0,0 +1,43 @@
+#include <cstddef>
+#include <optional>
+
+#include "dlt.h"
+
+// The parts of dlt that allocate on the heap are kept in this file, so that
+// the size and allocation report shows that dlt.cpp, used by static_dlt,
+// doesn't.
+
+constexpr std::size_t dlt_heap_segment_batch = 16;     // Number of packets given to the kernel at once
+
+rjcp::log::dlt::dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, std::string_view ecuid, std::string_view appid, std::string_view ctxid) noexcept
+    : m_sender{sender}
+    , m_dest{dest}
+    , m_heap_packet(max_packet + 1)
+    , m_storage{m_heap_packet.data(), m_heap_packet.size(), nullptr, nullptr, 0}
+{
+    this->init(ecuid, appid, ctxid, std::nullopt);
+}
+
+rjcp::log::dlt::dlt(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, std::string_view ecuid, std::string_view appid, std::string_view ctxid, std::uint32_t seid) noexcept
+    : m_sender{sender}
+    , m_dest{dest}
+    , m_heap_packet(max_packet + 1)
+    , m_storage{m_heap_packet.data(), m_heap_packet.size(), nullptr, nullptr, 0}
+{
+    this->init(ecuid, appid, ctxid, seid);
+}
+
+auto rjcp::log::dlt::alloc_segments() noexcept -> bool
+{
+    // Only a dlt with heap buffers allocates. A static_dlt without segments
+    // can't write segmented messages.
+    if (this->m_heap_packet.empty())
+        return false;
+
+    this->m_heap_segments.resize(dlt_heap_segment_batch * segment_packet);
+    this->m_heap_datagrams.resize(dlt_heap_segment_batch);
+    this->m_storage.segments = this->m_heap_segments.data();
+    this->m_storage.datagrams = this->m_heap_datagrams.data();
+    this->m_storage.segment_batch = dlt_heap_segment_batch;
+    return true;
+}
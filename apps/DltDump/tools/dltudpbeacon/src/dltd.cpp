@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+#include "dltd.h"
+
+constexpr std::string_view dltd_dropped_prefix = "dltd: ring full, ";
+constexpr std::string_view dltd_dropped_suffix = " messages dropped";
+constexpr std::size_t dltd_dropped_len = 64;
+
+// Gets the ID up to the first NUL.
+static auto id_view(const std::array<char, 4>& id) -> std::string_view
+{
+    return std::string_view(id.data(), std::find(id.begin(), id.end(), '\0') - id.begin());
+}
+
+rjcp::log::dltd::dltd(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, rjcp::ipc::shmring& rings, std::string_view ecuid) noexcept
+    : m_sender{sender}
+    , m_dest{dest}
+    , m_rings{rings}
+{
+    std::memcpy(this->m_ecuid.data(), ecuid.data(), std::min(ecuid.size(), this->m_ecuid.size()));
+}
+
+auto rjcp::log::dltd::client(std::size_t slot) noexcept -> rjcp::log::dlt*
+{
+    std::uint32_t generation = 0;
+    if (!this->m_rings.is_attached(slot, generation)) {
+        this->m_clients[slot].reset();
+        return nullptr;
+    }
+
+    if (!this->m_clients[slot] || this->m_generation[slot] != generation) {
+        std::array<char, 4> appid{};
+        std::array<char, 4> ctxid{};
+        this->m_rings.get_ids(slot, appid, ctxid);
+
+        this->m_seid++;
+        this->m_clients[slot].reset();
+        this->m_clients[slot].emplace(
+            this->m_sender, this->m_dest, id_view(this->m_ecuid), id_view(appid), id_view(ctxid), this->m_seid);
+        this->m_generation[slot] = generation;
+    }
+    return &*this->m_clients[slot];
+}
+
+auto rjcp::log::dltd::queue(rjcp::log::dlt& encoder, std::string_view message) noexcept -> int
+{
+    std::array<std::uint8_t, max_packet>& packet = this->m_batch[this->m_count];
+    int packet_len = encoder.encode(message, packet.data(), packet.size());
+    if (packet_len < 0)
+        return -1;
+
+    this->m_datagrams[this->m_count] = rjcp::net::udp4::datagram{
+        packet.data(), static_cast<std::size_t>(packet_len) };
+    this->m_count++;
+    if (this->m_count == max_batch)
+        return this->flush();
+    return 0;
+}
+
+auto rjcp::log::dltd::flush() noexcept -> int
+{
+    if (this->m_count == 0)
+        return 0;
+
+    // If the send fails, the batch is lost. Like any other UDP packet that is
+    // lost, there is no retry.
+    int res = this->m_sender.send(this->m_dest, this->m_datagrams.data(), this->m_count);
+    if (res == 0)
+        this->m_sent += static_cast<int>(this->m_count);
+    this->m_count = 0;
+    return res;
+}
+
+auto rjcp::log::dltd::run(int timeout_ms) noexcept -> int
+{
+    if (this->m_rings.wait(timeout_ms) < 0)
+        return -1;
+
+    this->m_sent = 0;
+    int res = 0;
+    int err = 0;
+    // Start at the next slot on every call, so that a client filling its ring
+    // faster than we send can't keep the others waiting.
+    const std::size_t first = this->m_next_slot;
+    this->m_next_slot = (first + 1) % rjcp::ipc::shmring::slots;
+    for (std::size_t i = 0; i < rjcp::ipc::shmring::slots; i++) {
+        const std::size_t slot = (first + i) % rjcp::ipc::shmring::slots;
+        rjcp::log::dlt* encoder = this->client(slot);
+        if (encoder == nullptr)
+            continue;
+
+        std::uint32_t dropped = this->m_rings.dropped(slot);
+        if (dropped > 0) {
+            // Formatted on the stack, so that reporting doesn't allocate.
+            std::array<char, dltd_dropped_len> message{};
+            std::size_t len = dltd_dropped_prefix.copy(message.data(), message.size());
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            const char* end = std::to_chars(&message[len], message.data() + message.size(), dropped).ptr;
+            len = end - message.data();
+            len += dltd_dropped_suffix.copy(&message[len], message.size() - len);
+            if (this->queue(*encoder, std::string_view(message.data(), len)) < 0) {
+                res = -1;
+                err = errno;
+            }
+        }
+
+        // Read at most a batch from each ring. What is left is read on the
+        // next call, which doesn't wait as the ring isn't empty.
+        for (std::size_t reads = 0; reads < max_batch; reads++) {
+            int msg_len = this->m_rings.read(slot, this->m_message.data(), this->m_message.size());
+            if (msg_len < 0) {
+                // The ring is empty, or was discarded as it was corrupted.
+                if (errno != EAGAIN) {
+                    res = -1;
+                    err = errno;
+                }
+                break;
+            }
+
+            if (this->queue(*encoder, std::string_view(
+                    reinterpret_cast<const char*>(this->m_message.data()), msg_len)) < 0) {  // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+                res = -1;
+                err = errno;
+            }
+        }
+
+        if (this->m_rings.release(slot))
+            this->m_clients[slot].reset();
+    }
+
+    if (this->flush() < 0) {
+        res = -1;
+        err = errno;
+    }
+
+    if (res < 0) {
+        errno = err;
+        return -1;
+    }
+    return this->m_sent;
+}
@@ -0,0 +1,95 @@
+#ifndef RJCP_DLTD_XX_H
+#define RJCP_DLTD_XX_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "dlt.h"
+#include "shmring.h"
+#include "sockaddr4.h"
+#include "udp4.h"
+
+namespace rjcp::log {
+    /**
+     * @brief Sends the messages of local client processes from shared memory
+     * over a single socket.
+     *
+     * Each client attached to the shared memory rings gets its own Session-ID
+     * when the daemon first sees it. Messages are read from all rings and
+     * encoded as DLT packets into a batch, which is sent with as few system
+     * calls as possible.
+     *
+     * All buffers are members of a fixed size, so that it doesn't allocate.
+     * The object is large (about 170 KiB), so on targets with a small stack,
+     * don't construct it on the stack.
+     *
+     * You should assume that all methods are not thread safe.
+     */
+    class dltd {
+    public:
+        /**
+         * @brief The maximum number of DLT packets sent together.
+         */
+        static constexpr std::size_t max_batch = 32;
+
+        /**
+         * @brief The maximum length of a DLT packet for a message from a client.
+         */
+        static constexpr std::size_t max_packet = rjcp::log::dlt::packet_len(rjcp::ipc::shmring::max_message);
+
+        /**
+         * @brief Construct a new dltd object
+         *
+         * @param sender The sender socket. Must already be opened and bound to before running.
+         * @param dest The address to send to (could be a multicast address).
+         * @param rings The shared memory rings. Must already be created before running.
+         * @param ecuid The ECU-ID (4 characters) in the standard header.
+         */
+        dltd(rjcp::net::udp4& sender, const rjcp::net::sockaddr4& dest, rjcp::ipc::shmring& rings, std::string_view ecuid) noexcept;
+
+        dltd(const dltd&) = delete;
+        auto operator=(const dltd&) -> dltd& = delete;
+
+        /**
+         * @brief Destroy the dltd object
+         *
+         */
+        ~dltd() = default;
+
+        /**
+         * @brief Waits for messages from clients and sends them.
+         *
+         * Call this in a loop. Up to max_batch messages are read from each
+         * ring on every call, so that one busy client can't keep the others
+         * waiting. The call only waits if all rings are empty.
+         *
+         * @param timeout_ms The maximum time to wait for a message, in milliseconds.
+         * @return int The number of DLT packets sent, -1 on error. Check errno.
+         */
+        auto run(int timeout_ms) noexcept -> int;
+
+    private:
+        auto client(std::size_t slot) noexcept -> rjcp::log::dlt*;
+        auto queue(rjcp::log::dlt& encoder, std::string_view message) noexcept -> int;
+        auto flush() noexcept -> int;
+
+        rjcp::net::udp4& m_sender;
+        const rjcp::net::sockaddr4& m_dest;
+        rjcp::ipc::shmring& m_rings;
+        std::array<char, 4> m_ecuid{};
+        std::uint32_t m_seid{0};
+        std::array<std::optional<rjcp::log::static_dlt<max_packet>>, rjcp::ipc::shmring::slots> m_clients{};
+        std::array<std::uint32_t, rjcp::ipc::shmring::slots> m_generation{};
+        std::array<std::uint8_t, rjcp::ipc::shmring::max_message> m_message{};
+        std::array<std::array<std::uint8_t, max_packet>, max_batch> m_batch{};
+        std::array<rjcp::net::udp4::datagram, max_batch> m_datagrams{};
+        std::size_t m_count{0};
+        std::size_t m_next_slot{0};
+        int m_sent{0};
+    };
+}
+
+#endif
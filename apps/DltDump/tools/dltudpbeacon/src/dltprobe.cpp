@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <string_view>
+
+#include "dlt.h"
+#include "dltprobe.h"
+
+constexpr std::string_view probe_prefix = "PROBE ";
+constexpr int mcnt_modulo = 256;
+
+// The state of each sequence number.
+constexpr std::uint8_t seq_missing = 0;         // Not received yet
+constexpr std::uint8_t seq_received = 1;        // Received
+constexpr std::uint8_t seq_mcnt_lost = 2;       // Not received yet, and counted in the MCNT loss
+constexpr double percent = 100.0;
+
+// Parses the unsigned integer at the start of text, and removes it with the
+// space following it.
+template<typename T>
+static auto parse(std::string_view& text, T& value) noexcept -> bool
+{
+    const char* end = text.data() + text.size();  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    if (ec != std::errc() || ptr == text.data())
+        return false;
+
+    text.remove_prefix(ptr - text.data());
+    if (!text.empty() && text.front() == ' ')
+        text.remove_prefix(1);
+    return true;
+}
+
+rjcp::log::dltprobe::dltprobe(std::size_t count) noexcept
+    : m_seq(count, seq_missing)
+{
+    this->m_latency.reserve(count);
+}
+
+auto rjcp::log::dltprobe::format(std::uint32_t seq, clock::time_point sent) -> std::string
+{
+    const auto sent_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sent.time_since_epoch()).count();
+    return std::string(probe_prefix) + std::to_string(seq) + " " + std::to_string(sent_ns);
+}
+
+auto rjcp::log::dltprobe::receive(const std::uint8_t* packet, std::size_t length, clock::time_point received) noexcept -> int
+{
+    std::uint8_t mcnt = 0;
+    std::string_view message;
+    if (rjcp::log::dlt::decode(packet, length, mcnt, message) < 0)
+        return -1;
+
+    std::uint32_t seq = 0;
+    std::chrono::nanoseconds::rep sent_ns = 0;
+    if (message.substr(0, probe_prefix.size()) != probe_prefix) {
+        errno = EBADMSG;
+        return -1;
+    }
+    message.remove_prefix(probe_prefix.size());
+    if (!parse(message, seq) || !parse(message, sent_ns) || !message.empty() || seq >= this->m_seq.size()) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    if (this->m_seq[seq] == seq_received) {
+        this->m_duplicates++;
+        return 0;
+    }
+    const bool mcnt_lost = this->m_seq[seq] == seq_mcnt_lost;
+    this->m_seq[seq] = seq_received;
+
+    const clock::time_point sent{std::chrono::duration_cast<clock::duration>(std::chrono::nanoseconds(sent_ns))};
+    this->m_latency.push_back(received - sent);
+    this->m_sorted = false;
+
+    if (this->m_first) {
+        this->m_first = false;
+        this->m_seq_high = seq;
+        this->m_mcnt = mcnt;
+        return 0;
+    }
+
+    if (seq > this->m_seq_high) {
+        // Only messages in order show a gap in the message counter. A gap of
+        // 256 messages or more wraps around and can't be seen.
+        const int mcnt_gap = (mcnt - this->m_mcnt - 1 + mcnt_modulo) % mcnt_modulo;
+        this->m_lost_mcnt += mcnt_gap;
+        if (static_cast<std::uint32_t>(mcnt_gap) == seq - this->m_seq_high - 1) {
+            // Each probe of the gap is counted, so a late probe can take its
+            // loss back.
+            for (std::uint32_t gap = this->m_seq_high + 1; gap < seq; gap++) {
+                if (this->m_seq[gap] == seq_missing)
+                    this->m_seq[gap] = seq_mcnt_lost;
+            }
+        }
+        this->m_mcnt = mcnt;
+        this->m_seq_high = seq;
+    } else {
+        this->m_reordered++;
+        if (mcnt_lost)
+            this->m_lost_mcnt--;
+    }
+    return 0;
+}
+
+auto rjcp::log::dltprobe::received() const noexcept -> std::size_t
+{
+    return this->m_latency.size();
+}
+
+auto rjcp::log::dltprobe::lost() const noexcept -> std::size_t
+{
+    return this->m_seq.size() - this->m_latency.size();
+}
+
+auto rjcp::log::dltprobe::lost_mcnt() const noexcept -> std::size_t
+{
+    return this->m_lost_mcnt;
+}
+
+auto rjcp::log::dltprobe::duplicates() const noexcept -> std::size_t
+{
+    return this->m_duplicates;
+}
+
+auto rjcp::log::dltprobe::reordered() const noexcept -> std::size_t
+{
+    return this->m_reordered;
+}
+
+auto rjcp::log::dltprobe::latency(double percentile) noexcept -> clock::duration
+{
+    if (this->m_latency.empty() || percentile < 0 || percentile > percent)
+        return clock::duration::zero();
+
+    if (!this->m_sorted) {
+        std::sort(this->m_latency.begin(), this->m_latency.end());
+        this->m_sorted = true;
+    }
+
+    const auto rank = static_cast<std::size_t>(std::ceil(percentile / percent * this->m_latency.size()));
+    return this->m_latency[std::max(rank, std::size_t{1}) - 1];
+}
@@ -0,0 +1,129 @@
+#ifndef RJCP_DLTPROBE_XX_H
+#define RJCP_DLTPROBE_XX_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rjcp::log {
+    /**
+     * @brief Measures one-way latency, reordering and loss of probe messages.
+     *
+     * The sender embeds a sequence number and the time of sending in the
+     * string argument of each DLT message, see format(). As the time is from
+     * the monotonic clock, the sender and the receiver must run on the same
+     * host, e.g. over loopback or with multicast loopback enabled.
+     *
+     * You should assume that all methods are not thread safe.
+     */
+    class dltprobe {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /**
+         * @brief Construct a new dltprobe object
+         *
+         * @param count The number of probes sent, with sequence numbers from
+         * zero. Memory is reserved for the latency and the state of each, so
+         * that receiving doesn't allocate.
+         */
+        explicit dltprobe(std::size_t count) noexcept;
+
+        /**
+         * @brief Destroy the dltprobe object
+         *
+         */
+        ~dltprobe() = default;
+
+        /**
+         * @brief Formats the payload of a probe message to send.
+         *
+         * @param seq The sequence number of the probe, starting from zero.
+         * @param sent The time the probe is sent.
+         * @return std::string The payload string to send as a DLT message.
+         */
+        static auto format(std::uint32_t seq, clock::time_point sent) -> std::string;
+
+        /**
+         * @brief Adds a received probe message to the statistics.
+         *
+         * @param packet The buffer with the received DLT packet.
+         * @param length The length of the received DLT packet.
+         * @param received The time the packet was received.
+         * @return int Success if zero, -1 on error. Check errno, which is
+         * EBADMSG if the packet isn't a probe message, or its sequence number
+         * is not less than the count of probes sent.
+         */
+        auto receive(const std::uint8_t* packet, std::size_t length, clock::time_point received) noexcept -> int;
+
+        /**
+         * @brief Gets the number of probe messages received, without duplicates.
+         *
+         * @return std::size_t The number of probe messages received.
+         */
+        auto received() const noexcept -> std::size_t;
+
+        /**
+         * @brief Gets the number of probe messages lost, from the sequence numbers.
+         *
+         * This includes probes lost before the first and after the last probe
+         * received.
+         *
+         * @return std::size_t The number of probes sent that weren't received.
+         */
+        auto lost() const noexcept -> std::size_t;
+
+        /**
+         * @brief Gets the number of probe messages lost, from the DLT message counter.
+         *
+         * The message counter is only 8 bits, so a gap of 256 or more
+         * messages wraps around and is not seen. A gap is counted when a later
+         * probe is received, and corrected when a probe of the gap is received
+         * late, so that reordering isn't counted as loss. Loss before the first
+         * and after the last probe received can't be seen either. The
+         * difference to lost() shows loss that a DLT receiver can't detect.
+         *
+         * @return std::size_t The number of messages missing in the message counter.
+         */
+        auto lost_mcnt() const noexcept -> std::size_t;
+
+        /**
+         * @brief Gets the number of probe messages received more than once.
+         *
+         * A duplicate is only counted here, and not in the other statistics.
+         *
+         * @return std::size_t The number of duplicate probe messages.
+         */
+        auto duplicates() const noexcept -> std::size_t;
+
+        /**
+         * @brief Gets the number of probe messages received after a later sequence number.
+         *
+         * @return std::size_t The number of probe messages received out of order.
+         */
+        auto reordered() const noexcept -> std::size_t;
+
+        /**
+         * @brief Gets a latency percentile of all probes received.
+         *
+         * @param percentile The percentile, in the range 0 to 100, e.g. 99.9.
+         * @return clock::duration The latency, using the nearest rank.
+         */
+        auto latency(double percentile) noexcept -> clock::duration;
+
+    private:
+        std::vector<clock::duration> m_latency;
+        std::vector<std::uint8_t> m_seq;
+        bool m_sorted{true};
+        bool m_first{true};
+        std::uint32_t m_seq_high{0};
+        std::uint8_t m_mcnt{0};
+        std::size_t m_lost_mcnt{0};
+        std::size_t m_reordered{0};
+        std::size_t m_duplicates{0};
+    };
+}
+
+#endif
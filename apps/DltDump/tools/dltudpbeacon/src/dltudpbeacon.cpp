@@ -1,18 +1,39 @@
 #include <cerrno>
+#include <charconv>
 #include <chrono>
+#include <csignal>
 #include <cstring>
 #include <iostream>
-#include <memory>
 #include <sstream>
 #include <string_view>
 #include <thread>
 #include <vector>
 
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "dltudpbeacon.h"
 #include "dlt.h"
+#include "dltd.h"
+#include "dltprobe.h"
+#include "shmring.h"
 #include "udp4.h"
 #include "sockaddr4.h"
 
+// The messages written are short, so the packets fit on the stack and writing
+// never allocates.
+constexpr std::size_t max_message = 256;
+constexpr std::size_t max_packet = rjcp::log::dlt::packet_len(max_message);
+constexpr std::size_t segment_batch = 16;
+
+static volatile std::sig_atomic_t stop = 0;
+
+static void stop_handler(int)
+{
+    stop = 1;
+}
+
 static void write_error(const std::string& message, int err)
 {
     std::cout << message << "; error " << std::strerror(err) << " (" << err << ")" << std::endl;
@@ -23,33 +44,38 @@ static void write_error(const std::string& message)
     write_error(message, errno);
 }
 
-auto main(int argc, char* argv[]) -> int
+static void write_usage(const std::string& program)
 {
-    std::vector<std::string> arguments(argv, argv + argc);
-    if (arguments.size() != 2) {
-        std::cout << "Usage: " << arguments[0] << " <localaddrip>" << std::endl;
-        return 1;
-    }
-
-    rjcp::net::sockaddr4 src(arguments[1], dlt_port);
-    rjcp::net::sockaddr4 dest(tx_multicast, dlt_port);
-    if (!dest.is_valid()) {
-        std::cout << "Usage: " << arguments[0] << " <localaddrip>" << std::endl;
-        std::cout << " Invalid address" << std::endl;
-        return 1;
-    }
+    std::cout << "Usage: " << program << " <localaddrip>" << std::endl;
+    std::cout << "       " << program << " -d <localaddrip>" << std::endl;
+    std::cout << "       " << program << " -c" << std::endl;
+    std::cout << "       " << program << " -p <localaddrip> [<count> [<interval_us>]]" << std::endl;
+    std::cout << "       " << program << " -f <localaddrip> <file>" << std::endl;
+    std::cout << std::endl;
+    std::cout << " -d  Run as a daemon, sending messages of local clients" << std::endl;
+    std::cout << " -c  Run as a client, writing messages to the daemon" << std::endl;
+    std::cout << " -p  Send probe messages to measure latency with dltudpprobe on this host" << std::endl;
+    std::cout << " -f  Send the file as a segmented network trace message" << std::endl;
+}
 
-    rjcp::net::udp4 udp;
+static auto parse_int(const std::string& text, int& value) -> bool
+{
+    const char* end = text.data() + text.size();  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end && value > 0;
+}
 
+static auto open_socket(rjcp::net::udp4& udp, rjcp::net::sockaddr4& src, rjcp::net::sockaddr4& dest, bool loop = false) -> int
+{
     if (udp.open() < 0) {
         write_error("open");
-        return 1;
+        return -1;
     }
 
     int bufsize = udp.get_sendbuf();
     std::cout << "Buffer size for socket: " << bufsize << std::endl;
 
-    if (udp.multicast_loop(dest, false) < 0)
+    if (udp.multicast_loop(dest, loop) < 0)
         write_error("setsockopt(IP_MULTICAST_LOOP)");
 
     if (udp.multicast_join(src) < 0)
@@ -67,22 +93,207 @@ auto main(int argc, char* argv[]) -> int
     if (udp.bind(src) < 0)
         write_error("bind");
 
-    rjcp::log::dlt dlt(udp, dest, "ECU1", "APP1", "CTX1");
+    return 0;
+}
 
+template<typename Writer>
+static void write_messages(const std::string& source, Writer writer)
+{
     constexpr int loops = 1000;     // Some arbitrary number before we finish
     constexpr int frequency = 2;    // 2 messages per second
     constexpr int delay = 1000 / frequency;
     int num = 1;
-    while(num < loops) {
+    while(num < loops && !stop) {
         std::stringstream ss;
-        ss << "A DLT message from " << arguments[1] << ". Count is " << num;
-        if (dlt.write(ss.str()) < 0)
-            write_error("dlt.write()");
+        ss << "A DLT message from " << source << ". Count is " << num;
+        writer(ss.str());
 
         num++;
         std::this_thread::sleep_for(std::chrono::milliseconds(delay));
     }
+}
+
+static auto run_beacon(const std::string& localaddr) -> int
+{
+    rjcp::net::sockaddr4 src(localaddr, dlt_port);
+    rjcp::net::sockaddr4 dest(tx_multicast, dlt_port);
+    if (!dest.is_valid()) {
+        std::cout << " Invalid address" << std::endl;
+        return 1;
+    }
+
+    rjcp::net::udp4 udp;
+    if (open_socket(udp, src, dest) < 0)
+        return 1;
+
+    rjcp::log::static_dlt<max_packet> dlt(udp, dest, "ECU1", "APP1", "CTX1");
+    write_messages(localaddr, [&dlt](const std::string& message) {
+        if (dlt.write(message) < 0)
+            write_error("dlt.write()");
+    });
 
     udp.close();
     return 0;
 }
+
+static auto run_daemon(const std::string& localaddr) -> int
+{
+    rjcp::net::sockaddr4 src(localaddr, dlt_port);
+    rjcp::net::sockaddr4 dest(tx_multicast, dlt_port);
+    if (!dest.is_valid()) {
+        std::cout << " Invalid address" << std::endl;
+        return 1;
+    }
+
+    rjcp::net::udp4 udp;
+    if (open_socket(udp, src, dest) < 0)
+        return 1;
+
+    rjcp::ipc::shmring rings;
+    if (rings.create(shm_name) < 0) {
+        write_error("shmring.create()");
+        return 1;
+    }
+
+    std::signal(SIGINT, stop_handler);
+    std::signal(SIGTERM, stop_handler);
+
+    constexpr int timeout_ms = 1000;
+    rjcp::log::dltd daemon(udp, dest, rings, "ECU1");
+    while (!stop) {
+        if (daemon.run(timeout_ms) < 0)
+            write_error("dltd.run()");
+    }
+
+    rings.close();
+    udp.close();
+    return 0;
+}
+
+static auto run_probe(const std::string& localaddr, int count, int interval_us) -> int
+{
+    rjcp::net::sockaddr4 src(localaddr, dlt_port);
+    rjcp::net::sockaddr4 dest(tx_multicast, dlt_port);
+    if (!dest.is_valid()) {
+        std::cout << " Invalid address" << std::endl;
+        return 1;
+    }
+
+    // The receiver must run on this host to compare the time stamps, so the
+    // multicast packets are looped back.
+    rjcp::net::udp4 udp;
+    if (open_socket(udp, src, dest, true) < 0)
+        return 1;
+
+    std::signal(SIGINT, stop_handler);
+    std::signal(SIGTERM, stop_handler);
+
+    rjcp::log::static_dlt<max_packet> dlt(udp, dest, "ECU1", "APP1", "PROB");
+    auto next = std::chrono::steady_clock::now();
+    for (int seq = 0; seq < count && !stop; seq++) {
+        std::string message = rjcp::log::dltprobe::format(seq, std::chrono::steady_clock::now());
+        if (dlt.write(message) < 0)
+            write_error("dlt.write()");
+
+        next += std::chrono::microseconds(interval_us);
+        std::this_thread::sleep_until(next);
+    }
+
+    udp.close();
+    return 0;
+}
+
+static auto run_file(const std::string& localaddr, const std::string& path) -> int
+{
+    rjcp::net::sockaddr4 src(localaddr, dlt_port);
+    rjcp::net::sockaddr4 dest(tx_multicast, dlt_port);
+    if (!dest.is_valid()) {
+        std::cout << " Invalid address" << std::endl;
+        return 1;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        write_error("open(" + path + ")");
+        return 1;
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) < 0) {
+        write_error("fstat(" + path + ")");
+        ::close(fd);
+        return 1;
+    }
+
+    rjcp::net::udp4 udp;
+    if (open_socket(udp, src, dest) < 0) {
+        ::close(fd);
+        return 1;
+    }
+
+    rjcp::log::static_dlt<max_packet, segment_batch> dlt(udp, dest, "ECU1", "APP1", "FILE");
+    if (dlt.write("Sending " + path) < 0)
+        write_error("dlt.write()");
+    if (dlt.write_segmented(fd, static_cast<std::size_t>(st.st_size)) < 0)
+        write_error("dlt.write_segmented()");
+
+    ::close(fd);
+    udp.close();
+    return 0;
+}
+
+static auto run_client() -> int
+{
+    rjcp::ipc::shmring ring;
+    if (ring.open(shm_name) < 0) {
+        write_error("shmring.open()");
+        return 1;
+    }
+
+    if (ring.attach("APP1", "CTX1") < 0) {
+        write_error("shmring.attach()");
+        return 1;
+    }
+
+    std::signal(SIGINT, stop_handler);
+    std::signal(SIGTERM, stop_handler);
+
+    std::stringstream source;
+    source << "client " << ::getpid();
+    write_messages(source.str(), [&ring](const std::string& message) {
+        if (ring.write(message) < 0)
+            write_error("shmring.write()");
+    });
+
+    ring.close();
+    return 0;
+}
+
+auto main(int argc, char* argv[]) -> int
+{
+    std::vector<std::string> arguments(argv, argv + argc);
+    if (arguments.size() == 2 && arguments[1] == "-c")
+        return run_client();
+
+    if (arguments.size() == 3 && arguments[1] == "-d")
+        return run_daemon(arguments[2]);
+
+    if (arguments.size() >= 3 && arguments.size() <= 5 && arguments[1] == "-p") {
+        constexpr int default_count = 10000;
+        constexpr int default_interval_us = 1000;
+        int count = default_count;
+        int interval_us = default_interval_us;
+        if ((arguments.size() < 4 || parse_int(arguments[3], count)) &&
+            (arguments.size() < 5 || parse_int(arguments[4], interval_us)))
+            return run_probe(arguments[2], count, interval_us);
+    }
+
+    if (arguments.size() == 4 && arguments[1] == "-f")
+        return run_file(arguments[2], arguments[3]);
+
+    if (arguments.size() == 2 && arguments[1][0] != '-')
+        return run_beacon(arguments[1]);
+
+    write_usage(arguments[0]);
+    return 1;
+}
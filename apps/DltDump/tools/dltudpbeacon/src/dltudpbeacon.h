@@ -7,4 +7,7 @@ constexpr int dlt_port(3490);
 // Change this to be the multicast address to transmit the packets on.
 constexpr const char* tx_multicast("239.255.42.99");
 
+// The name of the shared memory object between the daemon and its clients.
+constexpr const char* shm_name("/dltudpbeacon");
+
 #endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "dltudpbeacon.h"
+#include "dltprobe.h"
+#include "udp4.h"
+#include "sockaddr4.h"
+
+static void write_error(const std::string& message, int err)
+{
+    std::cout << message << "; error " << std::strerror(err) << " (" << err << ")" << std::endl;
+}
+
+static void write_error(const std::string& message)
+{
+    write_error(message, errno);
+}
+
+static void write_latency(const std::string& name, rjcp::log::dltprobe::clock::duration latency)
+{
+    const auto latency_us = std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(latency);
+    std::cout << " " << name << ": " << latency_us.count() << "us" << std::endl;
+}
+
+auto main(int argc, char* argv[]) -> int
+{
+    constexpr int default_count = 10000;
+    int count = default_count;
+
+    std::vector<std::string> arguments(argv, argv + argc);
+    if (arguments.size() == 3) {
+        const char* end = arguments[2].data() + arguments[2].size();  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        auto [ptr, ec] = std::from_chars(arguments[2].data(), end, count);
+        if (ec != std::errc() || ptr != end || count <= 0)
+            arguments.clear();
+    }
+    if (arguments.size() != 2 && arguments.size() != 3) {
+        std::cout << "Usage: " << argv[0] << " <localaddrip> [<count>]" << std::endl;
+        std::cout << std::endl;
+        std::cout << " Receives probe messages from 'dltudpbeacon -p' on this host." << std::endl;
+        return 1;
+    }
+
+    rjcp::net::sockaddr4 local(arguments[1], dlt_port);
+    rjcp::net::sockaddr4 any("0.0.0.0", dlt_port);
+    rjcp::net::sockaddr4 group(tx_multicast, dlt_port);
+    if (!local.is_valid() || !group.is_valid()) {
+        std::cout << " Invalid address" << std::endl;
+        return 1;
+    }
+
+    rjcp::net::udp4 udp;
+    if (udp.open() < 0) {
+        write_error("open");
+        return 1;
+    }
+
+    // Enough for bursts of probes, so that loss is from the path and not us.
+    constexpr int recvbuf = 4 * 1024 * 1024;
+    if (udp.set_recvbuf(recvbuf) < 0)
+        write_error("setsockopt(SO_RCVBUF)");
+
+    if (udp.reuseaddr(true) < 0)
+        write_error("setsockopt(SO_REUSEADDR)");
+
+    if (udp.reuseport(true) < 0)
+        write_error("setsockopt(SO_REUSEPORT)");
+
+    if (udp.bind(any) < 0) {
+        write_error("bind");
+        return 1;
+    }
+
+    if (udp.multicast_membership(group, local) < 0) {
+        write_error("setsockopt(IP_ADD_MEMBERSHIP)");
+        return 1;
+    }
+
+    // Stop if the sender stopped, after the probes that were lost.
+    constexpr int timeout_ms = 2000;
+    if (udp.set_recvtimeout(timeout_ms) < 0)
+        write_error("setsockopt(SO_RCVTIMEO)");
+
+    rjcp::log::dltprobe probe(count);
+    std::vector<uint8_t> packet(std::numeric_limits<uint16_t>::max());
+    int ignored = 0;
+    while (static_cast<int>(probe.received()) < count) {
+        int length = udp.recv(packet);
+        const auto received = rjcp::log::dltprobe::clock::now();
+        if (length < 0) {
+            if (errno == EAGAIN && probe.received() > 0)
+                break;
+            if (errno != EAGAIN && errno != EINTR)
+                write_error("recv");
+            continue;
+        }
+
+        if (probe.receive(packet.data(), length, received) < 0)
+            ignored++;
+    }
+
+    std::cout << "Received: " << probe.received() << std::endl;
+    std::cout << "Ignored: " << ignored << std::endl;
+    std::cout << "Lost (sequence): " << probe.lost() << std::endl;
+    std::cout << "Lost (MCNT): " << probe.lost_mcnt() << std::endl;
+    std::cout << "Reordered: " << probe.reordered() << std::endl;
+    std::cout << "Duplicates: " << probe.duplicates() << std::endl;
+    std::cout << "Latency:" << std::endl;
+    write_latency("p50", probe.latency(50));  // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+    write_latency("p99", probe.latency(99));  // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+    write_latency("p99.9", probe.latency(99.9));  // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+    write_latency("max", probe.latency(100));  // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+
+    udp.close();
+    return 0;
+}
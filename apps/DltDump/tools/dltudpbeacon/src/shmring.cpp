@@ -0,0 +1,480 @@
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include "config.h"
+#include "shmring.h"
+
+#ifdef HAVE_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+constexpr std::uint32_t shmring_magic = 0x444C5452;     // "DLTR"
+constexpr std::uint32_t shmring_version = 3;
+constexpr std::size_t shmring_size = 65536;             // Size of each ring, must be a power of two
+constexpr std::size_t shmring_len_header = sizeof(std::uint16_t);
+constexpr std::size_t shmring_cacheline = 64;
+constexpr int shmring_poll_ms = 10;                     // Polling interval if there is no futex
+
+static_assert((shmring_size & (shmring_size - 1)) == 0, "shmring_size must be a power of two");
+static_assert(rjcp::ipc::shmring::max_message + shmring_len_header <= shmring_size, "max_message too large");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "atomics in shared memory must be lock free");
+
+constexpr std::uint32_t slot_free = 0;                  // No client, the daemon ignores the slot
+constexpr std::uint32_t slot_claimed = 1;               // A client is initializing the slot
+constexpr std::uint32_t slot_attached = 2;              // A client is writing to the slot
+constexpr std::uint32_t slot_detached = 3;              // The client is gone, the daemon drains and frees the slot
+
+struct shmslot {
+    std::atomic<std::uint32_t> state;
+    std::atomic<std::uint32_t> generation;
+    std::atomic<std::int32_t> pid;
+    std::atomic<std::uint32_t> dropped;
+    std::array<char, 4> appid;
+    std::array<char, 4> ctxid;
+
+    // The producer and consumer indices are free running, and are on their own
+    // cache lines so that the client and daemon don't share them on write.
+    alignas(shmring_cacheline) std::atomic<std::uint32_t> head;
+    alignas(shmring_cacheline) std::atomic<std::uint32_t> tail;
+    alignas(shmring_cacheline) std::array<std::uint8_t, shmring_size> data;
+};
+
+struct shmheader {
+    std::atomic<std::uint32_t> magic;
+    std::uint32_t version;
+    std::atomic<std::uint32_t> wakeup;                  // Futex word, incremented on every write
+    std::atomic<std::uint32_t> sleeping;                // Non-zero if the daemon is waiting on the futex
+    std::array<shmslot, rjcp::ipc::shmring::slots> slot;
+};
+
+static auto header(void* shm) noexcept -> shmheader*
+{
+    return static_cast<shmheader*>(shm);
+}
+
+static void ring_write(shmslot& slot, std::uint32_t pos, const void* src, std::size_t len)
+{
+    const std::size_t offset = pos & (shmring_size - 1);
+    const std::size_t first = std::min(len, shmring_size - offset);
+    const auto* bytes = static_cast<const std::uint8_t*>(src);
+    std::memcpy(&slot.data[offset], bytes, first);
+    std::memcpy(slot.data.data(), bytes + first, len - first);  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+static void ring_read(const shmslot& slot, std::uint32_t pos, void* dest, std::size_t len)
+{
+    const std::size_t offset = pos & (shmring_size - 1);
+    const std::size_t first = std::min(len, shmring_size - offset);
+    auto* bytes = static_cast<std::uint8_t*>(dest);
+    std::memcpy(bytes, &slot.data[offset], first);
+    std::memcpy(bytes + first, slot.data.data(), len - first);  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+static void write4id(std::string_view id, std::array<char, 4>& field)
+{
+    field.fill(0);
+    std::memcpy(field.data(), id.data(), std::min(id.length(), field.size()));
+}
+
+static auto is_alive(pid_t pid) -> bool
+{
+    return pid > 0 && (::kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+// Tests if the segment of the name refers to the file of the stat.
+static auto is_segment(const std::string& name, const struct stat& st) -> bool
+{
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat name_st{};
+    bool same = ::fstat(fd, &name_st) == 0 && name_st.st_dev == st.st_dev && name_st.st_ino == st.st_ino;
+    ::close(fd);
+    return same;
+}
+
+// Unlinks the segment of the name if it is left over from a daemon that is
+// gone. A running daemon holds an exclusive lock on its segment, which is
+// released by the kernel when it exits, however it exits. The lock is held
+// while unlinking, so that a daemon starting at the same time can't create a
+// segment that we would unlink.
+static auto unlink_stale(const std::string& name) -> bool
+{
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return errno == ENOENT;
+
+    if (::flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        ::close(fd);
+        return false;
+    }
+
+    struct stat st{};
+    bool stale = ::fstat(fd, &st) == 0 && is_segment(name, st);
+    if (stale)
+        ::shm_unlink(name.c_str());
+    ::close(fd);
+    return stale;
+}
+
+static void notify(shmheader* hdr)
+{
+    hdr->wakeup.fetch_add(1);
+    if (hdr->sleeping.load() != 0) {
+#ifdef HAVE_FUTEX
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-type-vararg): Systems programming.
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&hdr->wakeup), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+    }
+}
+
+rjcp::ipc::shmring::~shmring() noexcept
+{
+    if (this->is_open())
+        close();
+}
+
+auto rjcp::ipc::shmring::create(const std::string& name) noexcept -> int
+{
+    if (this->is_open()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    constexpr mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP;
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+    if (fd < 0 && errno == EEXIST) {
+        // Only replace the segment of a daemon that is gone. Taking it from a
+        // running daemon would orphan the clients attached to it.
+        if (!unlink_stale(name)) {
+            errno = EBUSY;
+            return -1;
+        }
+        fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, mode);
+        if (fd < 0 && errno == EEXIST)
+            errno = EBUSY;
+    }
+    if (fd < 0)
+        return -1;
+
+    // Another daemon might have locked our segment as stale before we could,
+    // and replaced it. Then it is running and we aren't.
+    struct stat st{};
+    if (::flock(fd, LOCK_EX | LOCK_NB) < 0 || ::fstat(fd, &st) < 0 || !is_segment(name, st)) {
+        ::close(fd);
+        errno = EBUSY;
+        return -1;
+    }
+
+    if (::ftruncate(fd, sizeof(shmheader)) < 0) {
+        int err = errno;
+        ::shm_unlink(name.c_str());
+        ::close(fd);
+        errno = err;
+        return -1;
+    }
+
+    if (this->map(fd, true) < 0) {
+        int err = errno;
+        ::shm_unlink(name.c_str());
+        ::close(fd);
+        errno = err;
+        return -1;
+    }
+
+    // The file stays open to hold the lock while running.
+    this->m_name = name;
+    this->m_owner = true;
+    this->m_lock_fd = fd;
+    this->m_dev = st.st_dev;
+    this->m_ino = st.st_ino;
+    return 0;
+}
+
+auto rjcp::ipc::shmring::open(const std::string& name) noexcept -> int
+{
+    if (this->is_open()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return -1;
+
+    struct stat st{};
+    if (::fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(shmheader)) {
+        ::close(fd);
+        errno = EPROTO;
+        return -1;
+    }
+
+    int res = this->map(fd, false);
+    int err = errno;
+    ::close(fd);
+    if (res < 0) {
+        errno = err;
+        return -1;
+    }
+
+    this->m_name = name;
+    return 0;
+}
+
+auto rjcp::ipc::shmring::map(int fd, bool init) noexcept -> int
+{
+    void* shm = ::mmap(nullptr, sizeof(shmheader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shm == MAP_FAILED)      // NOLINT(cppcoreguidelines-pro-type-cstyle-cast): MAP_FAILED is a macro.
+        return -1;
+
+    if (init) {
+        // The memory is already zero from ftruncate(), which is the free state
+        // for all slots. Only the object lifetime needs to start.
+        shmheader* hdr = new (shm) shmheader;
+        hdr->version = shmring_version;
+        hdr->magic.store(shmring_magic, std::memory_order_release);
+    } else {
+        shmheader* hdr = header(shm);
+        if (hdr->magic.load(std::memory_order_acquire) != shmring_magic ||
+            hdr->version != shmring_version) {
+            ::munmap(shm, sizeof(shmheader));
+            errno = EPROTO;
+            return -1;
+        }
+    }
+
+    this->m_shm = shm;
+    return 0;
+}
+
+auto rjcp::ipc::shmring::is_open() const noexcept -> bool
+{
+    return this->m_shm != nullptr;
+}
+
+auto rjcp::ipc::shmring::attach(std::string_view appid, std::string_view ctxid) noexcept -> int
+{
+    if (!this->is_open() || this->m_owner || this->m_slot >= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    shmheader* hdr = header(this->m_shm);
+    for (std::size_t i = 0; i < slots; i++) {
+        shmslot& slot = hdr->slot[i];
+        std::uint32_t state = slot_free;
+        if (slot.state.compare_exchange_strong(state, slot_claimed, std::memory_order_acq_rel)) {
+            write4id(appid, slot.appid);
+            write4id(ctxid, slot.ctxid);
+            slot.pid.store(::getpid(), std::memory_order_relaxed);
+            slot.dropped.store(0, std::memory_order_relaxed);
+            slot.head.store(0, std::memory_order_relaxed);
+            slot.tail.store(0, std::memory_order_relaxed);
+            slot.generation.fetch_add(1, std::memory_order_relaxed);
+            slot.state.store(slot_attached, std::memory_order_release);
+            this->m_slot = static_cast<int>(i);
+            return 0;
+        }
+    }
+
+    errno = EBUSY;
+    return -1;
+}
+
+auto rjcp::ipc::shmring::write(std::string_view message) noexcept -> int
+{
+    if (!this->is_open() || this->m_slot < 0 || message.size() > max_message) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    shmheader* hdr = header(this->m_shm);
+    shmslot& slot = hdr->slot[this->m_slot];
+    const std::uint32_t head = slot.head.load(std::memory_order_relaxed);
+    const std::uint32_t tail = slot.tail.load(std::memory_order_acquire);
+    const std::size_t length = shmring_len_header + message.size();
+    if (shmring_size - (head - tail) < length) {
+        slot.dropped.fetch_add(1, std::memory_order_relaxed);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    const auto msg_len = static_cast<std::uint16_t>(message.size());
+    ring_write(slot, head, &msg_len, shmring_len_header);
+    ring_write(slot, head + shmring_len_header, message.data(), message.size());
+    slot.head.store(head + length, std::memory_order_release);
+
+    notify(hdr);
+    return 0;
+}
+
+auto rjcp::ipc::shmring::wait(int timeout_ms) noexcept -> int
+{
+    if (!this->is_open() || !this->m_owner || timeout_ms < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // A client increments the futex word after writing, and only wakes us if
+    // it sees that we're sleeping. So we must check the rings after announcing
+    // that we sleep, else a message written just before might wait for the
+    // timeout.
+    shmheader* hdr = header(this->m_shm);
+    hdr->sleeping.store(1);
+    const std::uint32_t wakeup = hdr->wakeup.load();
+    bool pending = false;
+    for (const shmslot& slot : hdr->slot) {
+        if (slot.head.load(std::memory_order_acquire) != slot.tail.load(std::memory_order_relaxed)) {
+            pending = true;
+            break;
+        }
+    }
+
+    int res = 0;
+    if (!pending) {
+#ifdef HAVE_FUTEX
+        constexpr long ms_per_sec = 1000;
+        constexpr long ns_per_ms = 1000000;
+        struct timespec timeout{};
+        timeout.tv_sec = timeout_ms / ms_per_sec;
+        timeout.tv_nsec = (timeout_ms % ms_per_sec) * ns_per_ms;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-type-vararg): Systems programming.
+        res = static_cast<int>(::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&hdr->wakeup), FUTEX_WAIT, wakeup, &timeout, nullptr, 0));
+        if (res < 0 && (errno == EAGAIN || errno == ETIMEDOUT || errno == EINTR))
+            res = 0;
+#else
+        (void)wakeup;
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, shmring_poll_ms)));
+#endif
+    }
+
+    hdr->sleeping.store(0);
+    return res < 0 ? -1 : 0;
+}
+
+auto rjcp::ipc::shmring::is_attached(std::size_t slot, std::uint32_t& generation) const noexcept -> bool
+{
+    if (!this->is_open() || slot >= slots)
+        return false;
+
+    const shmslot& s = header(this->m_shm)->slot[slot];
+    const std::uint32_t state = s.state.load(std::memory_order_acquire);
+    generation = s.generation.load(std::memory_order_relaxed);
+    return state == slot_attached || state == slot_detached;
+}
+
+auto rjcp::ipc::shmring::get_ids(std::size_t slot, std::array<char, 4>& appid, std::array<char, 4>& ctxid) const noexcept -> void
+{
+    if (!this->is_open() || slot >= slots)
+        return;
+
+    const shmslot& s = header(this->m_shm)->slot[slot];
+    appid = s.appid;
+    ctxid = s.ctxid;
+}
+
+auto rjcp::ipc::shmring::read(std::size_t slot, std::uint8_t* buffer, std::size_t length) noexcept -> int
+{
+    if (!this->is_open() || slot >= slots || buffer == nullptr || length < max_message) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    shmslot& s = header(this->m_shm)->slot[slot];
+    const std::uint32_t tail = s.tail.load(std::memory_order_relaxed);
+    const std::uint32_t head = s.head.load(std::memory_order_acquire);
+    if (head == tail) {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    std::uint16_t msg_len = 0;
+    ring_read(s, tail, &msg_len, shmring_len_header);
+    if (msg_len > max_message || shmring_len_header + msg_len > head - tail) {
+        // The client corrupted its ring. Discard everything it wrote.
+        s.tail.store(head, std::memory_order_release);
+        errno = EBADMSG;
+        return -1;
+    }
+
+    ring_read(s, tail + shmring_len_header, buffer, msg_len);
+    s.tail.store(tail + shmring_len_header + msg_len, std::memory_order_release);
+    return msg_len;
+}
+
+auto rjcp::ipc::shmring::release(std::size_t slot) noexcept -> bool
+{
+    if (!this->is_open() || slot >= slots)
+        return false;
+
+    shmslot& s = header(this->m_shm)->slot[slot];
+    std::uint32_t state = s.state.load(std::memory_order_acquire);
+    if (state == slot_attached) {
+        // A client that crashed never detaches.
+        if (is_alive(s.pid.load(std::memory_order_relaxed)))
+            return false;
+    } else if (state != slot_detached) {
+        return false;
+    }
+
+    if (s.head.load(std::memory_order_acquire) != s.tail.load(std::memory_order_relaxed))
+        return false;
+
+    return s.state.compare_exchange_strong(state, slot_free, std::memory_order_acq_rel);
+}
+
+auto rjcp::ipc::shmring::dropped(std::size_t slot) noexcept -> std::uint32_t
+{
+    if (!this->is_open() || slot >= slots)
+        return 0;
+
+    return header(this->m_shm)->slot[slot].dropped.exchange(0, std::memory_order_relaxed);
+}
+
+auto rjcp::ipc::shmring::close() noexcept -> int
+{
+    if (!this->is_open()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    shmheader* hdr = header(this->m_shm);
+    if (this->m_slot >= 0) {
+        hdr->slot[this->m_slot].state.store(slot_detached, std::memory_order_release);
+        notify(hdr);
+        this->m_slot = -1;
+    }
+
+    int res = ::munmap(this->m_shm, sizeof(shmheader));
+    this->m_shm = nullptr;
+    if (this->m_owner) {
+        // Only unlink the name if it still refers to our segment, and while
+        // still holding the lock.
+        struct stat st{};
+        st.st_dev = this->m_dev;
+        st.st_ino = this->m_ino;
+        if (is_segment(this->m_name, st))
+            ::shm_unlink(this->m_name.c_str());
+        ::close(this->m_lock_fd);
+        this->m_lock_fd = -1;
+        this->m_owner = false;
+    }
+    return res;
+}
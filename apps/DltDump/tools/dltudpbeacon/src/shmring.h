@@ -0,0 +1,186 @@
+#ifndef RJCP_IPC_SHMRING_XX_H
+#define RJCP_IPC_SHMRING_XX_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include <sys/types.h>
+
+namespace rjcp::ipc {
+    /**
+     * @brief Per-process log message ring buffers in POSIX shared memory.
+     *
+     * The shared memory segment is created by a single daemon process, which
+     * is the consumer for all rings. Client processes open the segment and
+     * attach to a free slot, so that each client has its own single-producer,
+     * single-consumer ring. Writing a message is a copy into shared memory
+     * and doesn't need a system call, unless the daemon is sleeping and must
+     * be woken up (with a futex on Linux).
+     *
+     * You should assume that all methods are not thread safe. A client may
+     * only write to the ring from one thread.
+     */
+    class shmring {
+    public:
+        /**
+         * @brief The number of client slots in the shared memory segment.
+         */
+        static constexpr std::size_t slots = 8;
+
+        /**
+         * @brief The maximum length of a single message in a ring.
+         */
+        static constexpr std::size_t max_message = 4096;
+
+        /**
+         * @brief Construct a new shmring object
+         */
+        shmring() = default;
+
+        /**
+         * @brief Destroy the shmring object
+         *
+         * Detaches the client from its slot and unmaps the shared memory.
+         */
+        ~shmring() noexcept;
+
+        shmring(const shmring&) = delete;
+        auto operator=(const shmring&) -> shmring& = delete;
+
+        /**
+         * @brief Creates and maps the shared memory segment (daemon).
+         *
+         * A stale segment of the same name, left over from a daemon that
+         * didn't exit cleanly, is replaced. A segment of a daemon that is
+         * still running is not, which is known by the lock the daemon holds
+         * on the segment until it is closed.
+         *
+         * @param name The name of the shared memory object, e.g. "/dltudpbeacon".
+         * @return int Success if zero, -1 on error. Check errno. If another
+         * daemon is running, errno is EBUSY.
+         */
+        auto create(const std::string& name) noexcept -> int;
+
+        /**
+         * @brief Maps an existing shared memory segment created by the daemon (client).
+         *
+         * @param name The name of the shared memory object, e.g. "/dltudpbeacon".
+         * @return int Success if zero, -1 on error. Check errno.
+         */
+        auto open(const std::string& name) noexcept -> int;
+
+        /**
+         * @brief Tests if the shared memory segment is mapped
+         *
+         * @return true if the segment is mapped.
+         * @return false if the segment is not mapped.
+         */
+        auto is_open() const noexcept -> bool;
+
+        /**
+         * @brief Claims a free ring for this process (client).
+         *
+         * @param appid The Application-ID (4 characters) the daemon uses for messages from this ring.
+         * @param ctxid The Context-ID (4 characters) the daemon uses for messages from this ring.
+         * @return int Success if zero, -1 on error. Check errno. If all slots
+         * are in use, errno is EBUSY.
+         */
+        auto attach(std::string_view appid, std::string_view ctxid) noexcept -> int;
+
+        /**
+         * @brief Copies a message into the ring of this process (client).
+         *
+         * The message is dropped if the ring is full, so that the client never
+         * blocks on the daemon.
+         *
+         * @param message The payload string.
+         * @return int Success if zero, -1 on error. Check errno. If the ring is
+         * full, errno is EAGAIN.
+         */
+        auto write(std::string_view message) noexcept -> int;
+
+        /**
+         * @brief Waits until a client writes a message or the timeout expires (daemon).
+         *
+         * @param timeout_ms The maximum time to wait, in milliseconds.
+         * @return int Zero if woken or the timeout expired, -1 on error. Check errno.
+         */
+        auto wait(int timeout_ms) noexcept -> int;
+
+        /**
+         * @brief Tests if a client is attached to the slot (daemon).
+         *
+         * Also returns true if the client has detached, but there are still
+         * messages in the ring.
+         *
+         * @param slot The slot index, less than slots.
+         * @param generation Receives a counter that changes each time a client attaches to the slot.
+         * @return true if the slot has a client or pending messages.
+         * @return false if the slot is free.
+         */
+        auto is_attached(std::size_t slot, std::uint32_t& generation) const noexcept -> bool;
+
+        /**
+         * @brief Gets the Application-ID and Context-ID given by the client on attach (daemon).
+         *
+         * @param slot The slot index, less than slots.
+         * @param appid Receives the Application-ID, padded with NUL if shorter than 4 characters.
+         * @param ctxid Receives the Context-ID, padded with NUL if shorter than 4 characters.
+         */
+        auto get_ids(std::size_t slot, std::array<char, 4>& appid, std::array<char, 4>& ctxid) const noexcept -> void;
+
+        /**
+         * @brief Copies the next message from the ring in the slot (daemon).
+         *
+         * @param slot The slot index, less than slots.
+         * @param buffer The buffer that receives the message.
+         * @param length The length of buffer, at least max_message bytes.
+         * @return int The length of the message, which may be zero, -1 on error. Check errno.
+         * If the ring is empty, errno is EAGAIN.
+         */
+        auto read(std::size_t slot, std::uint8_t* buffer, std::size_t length) noexcept -> int;
+
+        /**
+         * @brief Frees a slot once its client has detached or died and the ring is empty (daemon).
+         *
+         * @param slot The slot index, less than slots.
+         * @return true if the slot was freed.
+         * @return false if the slot is still in use.
+         */
+        auto release(std::size_t slot) noexcept -> bool;
+
+        /**
+         * @brief Gets and resets the number of messages dropped by the client as the ring was full (daemon).
+         *
+         * @param slot The slot index, less than slots.
+         * @return std::uint32_t The number of messages dropped.
+         */
+        auto dropped(std::size_t slot) noexcept -> std::uint32_t;
+
+        /**
+         * @brief Detaches from the slot and unmaps the shared memory.
+         *
+         * If this object created the segment, and the name still refers to
+         * it, the name is also unlinked.
+         *
+         * @return int Success if zero, -1 on error. Check errno.
+         */
+        auto close() noexcept -> int;
+
+    private:
+        auto map(int fd, bool init) noexcept -> int;
+
+        void* m_shm{nullptr};
+        std::string m_name{};
+        bool m_owner{false};
+        int m_lock_fd{-1};
+        dev_t m_dev{0};
+        ino_t m_ino{0};
+        int m_slot{-1};
+    };
+}
+
+#endif
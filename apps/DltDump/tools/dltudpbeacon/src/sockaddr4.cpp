@@ -5,7 +5,6 @@
 #include <unistd.h>
 
 #include <cstring>
-#include <iostream>
 #include <limits>
 
 #include "sockaddr4.h"
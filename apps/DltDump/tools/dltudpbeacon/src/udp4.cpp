@@ -1,11 +1,13 @@
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
-#include <iostream>
 #include <limits>
 #include <memory>
 #include <string>
@@ -19,7 +21,8 @@ constexpr int max_ttl = std::numeric_limits<uint8_t>::max();
 
 rjcp::net::udp4::~udp4() noexcept
 {
-    close();
+    if (this->is_open())
+        close();
 }
 
 auto rjcp::net::udp4::open() noexcept -> int
@@ -98,6 +101,25 @@ auto rjcp::net::udp4::multicast_join(sockaddr4& addr) noexcept -> int
 #endif
 }
 
+auto rjcp::net::udp4::multicast_membership(sockaddr4& group, sockaddr4& addr) noexcept -> int
+{
+    if (!group.is_valid() || !addr.is_valid() || !this->is_open()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+#ifdef HAVE_IP_ADD_MEMBERSHIP
+    ::ip_mreq mreq{};
+    mreq.imr_multiaddr = group.get().sin_addr;
+    mreq.imr_interface = addr.get().sin_addr;
+    return ::setsockopt(this->m_socket_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+        &mreq, sizeof(mreq));
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 auto rjcp::net::udp4::multicast_ttl(int ttl) noexcept -> int
 {
     if (ttl <= 0 || ttl > max_ttl || !this->is_open()) {
@@ -140,6 +162,33 @@ auto rjcp::net::udp4::get_sendbuf() noexcept -> int
     return buffsize;
 }
 
+auto rjcp::net::udp4::set_recvbuf(int recvbuf) noexcept -> int
+{
+    if (recvbuf <= 0 || !this->is_open()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return ::setsockopt(this->m_socket_fd, SOL_SOCKET, SO_RCVBUF,
+        &recvbuf, sizeof(recvbuf));
+}
+
+auto rjcp::net::udp4::set_recvtimeout(int timeout_ms) noexcept -> int
+{
+    if (timeout_ms < 0 || !this->is_open()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    constexpr int ms_per_sec = 1000;
+    constexpr int us_per_ms = 1000;
+    ::timeval timeout{};
+    timeout.tv_sec = timeout_ms / ms_per_sec;
+    timeout.tv_usec = (timeout_ms % ms_per_sec) * us_per_ms;
+    return ::setsockopt(this->m_socket_fd, SOL_SOCKET, SO_RCVTIMEO,
+        &timeout, sizeof(timeout));
+}
+
 auto rjcp::net::udp4::bind(sockaddr4& addr) noexcept -> int
 {
     if (!addr.is_valid() || !this->is_open()) {
@@ -160,7 +209,17 @@ auto rjcp::net::udp4::send(const sockaddr4& addr, const std::vector<uint8_t>& bu
 
 auto rjcp::net::udp4::send(const sockaddr4& addr, const std::vector<uint8_t>& buffer, std::size_t length) noexcept -> int
 {
-    if (!addr.is_valid() || !this->is_open()) {
+    if (length > buffer.size()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return this->send(addr, buffer.data(), length);
+}
+
+auto rjcp::net::udp4::send(const sockaddr4& addr, const std::uint8_t* buffer, std::size_t length) noexcept -> int
+{
+    if (!addr.is_valid() || !this->is_open() || buffer == nullptr) {
         errno = EINVAL;
         return -1;
     }
@@ -169,7 +228,7 @@ auto rjcp::net::udp4::send(const sockaddr4& addr, const std::vector<uint8_t>& bu
     auto destaddr = reinterpret_cast<const ::sockaddr*>(&addr.get());
     ssize_t nbytes = ::sendto(
         this->m_socket_fd,
-        buffer.data(), length,
+        buffer, length,
         0, destaddr, sizeof(::sockaddr_in));
 
     if (nbytes < 0)
@@ -178,12 +237,77 @@ auto rjcp::net::udp4::send(const sockaddr4& addr, const std::vector<uint8_t>& bu
     return 0;
 }
 
+auto rjcp::net::udp4::send(const sockaddr4& addr, const datagram* datagrams, std::size_t count) noexcept -> int
+{
+    if (!addr.is_valid() || !this->is_open() || (datagrams == nullptr && count > 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+#ifdef HAVE_SENDMMSG
+    constexpr std::size_t max_batch = 64;
+    std::array<::mmsghdr, max_batch> msgs{};
+    std::array<::iovec, max_batch> iovs{};
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast,cppcoreguidelines-pro-type-const-cast): Systems programming.
+    auto destaddr = const_cast<::sockaddr*>(reinterpret_cast<const ::sockaddr*>(&addr.get()));
+    std::size_t sent = 0;
+    while (sent < count) {
+        const std::size_t batch = std::min(count - sent, max_batch);
+        for (std::size_t i = 0; i < batch; i++) {
+            const datagram& dgram = datagrams[sent + i];  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast): The kernel doesn't write to the buffer.
+            iovs[i].iov_base = const_cast<uint8_t*>(dgram.data);
+            iovs[i].iov_len = dgram.length;
+            msgs[i].msg_hdr = ::msghdr{};
+            msgs[i].msg_hdr.msg_name = destaddr;
+            msgs[i].msg_hdr.msg_namelen = sizeof(::sockaddr_in);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int nmsgs = ::sendmmsg(this->m_socket_fd, msgs.data(), batch, 0);
+        if (nmsgs < 0)
+            return -1;
+
+        sent += nmsgs;
+    }
+    return 0;
+#else
+    for (std::size_t i = 0; i < count; i++) {
+        const datagram& dgram = datagrams[i];  // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        if (this->send(addr, dgram.data, dgram.length) < 0)
+            return -1;
+    }
+    return 0;
+#endif
+}
+
+auto rjcp::net::udp4::recv(std::vector<uint8_t>& buffer) noexcept -> int
+{
+    if (!this->is_open()) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ssize_t nbytes = ::recv(this->m_socket_fd, buffer.data(), buffer.size(), 0);
+    if (nbytes < 0) {
+        if (errno == EWOULDBLOCK)
+            errno = EAGAIN;
+        return -1;
+    }
+
+    return static_cast<int>(nbytes);
+}
+
 auto rjcp::net::udp4::close() noexcept -> int
 {
-    if (this->is_open()) {
+    if (!this->is_open()) {
         errno = EINVAL;
         return -1;
     }
 
-    return ::close(this->m_socket_fd);
+    int res = ::close(this->m_socket_fd);
+    this->m_socket_fd = -1;
+    return res;
 }
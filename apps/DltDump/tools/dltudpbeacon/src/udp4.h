@@ -1,6 +1,8 @@
 #ifndef RJCP_NET_UDP4_XX_H
 #define RJCP_NET_UDP4_XX_H
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <vector>
@@ -13,6 +15,14 @@ namespace rjcp::net {
      */
     class udp4 {
     public:
+        /**
+         * @brief A datagram to send in a batch.
+         */
+        struct datagram {
+            const std::uint8_t* data;
+            std::size_t length;
+        };
+
         /**
          * @brief Construct a new udp4 object
          */
@@ -59,6 +69,15 @@ namespace rjcp::net {
          */
         auto multicast_join(sockaddr4& addr) noexcept -> int;
 
+        /**
+         * @brief Join a multicast group to receive its datagrams.
+         *
+         * @param group The multicast group to join.
+         * @param addr The local interface to receive the multicast group on.
+         * @return int Success if zero, -1 on error. Check errno.
+         */
+        auto multicast_membership(sockaddr4& group, sockaddr4& addr) noexcept -> int;
+
         /**
          * @brief Set or read the time-to-live value of outgoing multicast
          * packets for this socket
@@ -104,6 +123,22 @@ namespace rjcp::net {
          */
         auto get_sendbuf() noexcept -> int;
 
+        /**
+         * @brief Set the amount of receive buffer for the socket.
+         *
+         * @param recvbuf The size of the bytes to receive.
+         * @return int Success if zero, -1 on error. Check errno.
+         */
+        auto set_recvbuf(int recvbuf) noexcept -> int;
+
+        /**
+         * @brief Set the maximum time recv() waits for a datagram.
+         *
+         * @param timeout_ms The timeout in milliseconds. Zero waits forever.
+         * @return int Success if zero, -1 on error. Check errno.
+         */
+        auto set_recvtimeout(int timeout_ms) noexcept -> int;
+
         /**
          * @brief Bind the socket to a particular address and port.
          *
@@ -131,6 +166,39 @@ namespace rjcp::net {
          */
         auto send(const sockaddr4& addr, const std::vector<uint8_t>& buffer, std::size_t length) noexcept -> int;
 
+        /**
+         * @brief Sends a UDP datagram to the specified address of a particular length.
+         *
+         * @param addr The address to send to.
+         * @param buffer The binary data to send.
+         * @param length The length of data to send from the start.
+         * @return int Success if zero, -1 on error. Check errno.
+         */
+        auto send(const sockaddr4& addr, const std::uint8_t* buffer, std::size_t length) noexcept -> int;
+
+        /**
+         * @brief Sends many UDP datagrams to the specified address.
+         *
+         * Where the OS supports it, the datagrams are given to the kernel with
+         * a single system call (sendmmsg) per batch.
+         *
+         * @param addr The address to send to.
+         * @param datagrams The datagrams to send.
+         * @param count The number of datagrams to send from the start of datagrams.
+         * @return int Success if zero, -1 on error. Check errno.
+         */
+        auto send(const sockaddr4& addr, const datagram* datagrams, std::size_t count) noexcept -> int;
+
+        /**
+         * @brief Receives a UDP datagram.
+         *
+         * @param buffer The buffer to receive into. Datagrams longer than the
+         * buffer are truncated.
+         * @return int The length of the datagram received, -1 on error. Check
+         * errno, which is EAGAIN if the receive timeout expired.
+         */
+        auto recv(std::vector<uint8_t>& buffer) noexcept -> int;
+
         /**
          * @brief Closes the UDP socket that it can't be used.
          *